@@ -0,0 +1,378 @@
+// icube_bench - conversions, sampling and codec timings on synthetic, deterministic inputs
+//
+// usage: icube_bench [--sizes 2048,4096,8192] [--reps 5] [--warmup 1] [--filter <substring>]
+//                    [--json <path>] [--tmp <folder>]
+//
+// Sizes are LatLong widths (the faces are a quarter of that, 2048 -> 512x512 faces).
+// Every case reports the median and p95 of the repetitions, plus ns/pixel, MP/s and GB/s
+// computed from the median, the JSON output is meant to be diffed between runs.
+
+#include "EnvironmentImage.h"
+#include "PixelPacking.h"
+#include "RemapTable.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+static const size_t sNumSampleDirs = size_t(1) << 20;
+static const char*  sCodecExtensions[] = { ".hdr", ".png", ".bmp", ".tga", ".jpg" };
+
+struct BenchOptions {
+    Array<size_t>   sizes = { 2048, 4096, 8192 };
+    size_t          reps = 5;
+    size_t          warmup = 1;
+    String          filter;
+    fs::path        jsonPath;
+    fs::path        tmpFolder = fs::temp_directory_path() / "icube_bench";
+};
+
+struct BenchResult {
+    String          name;
+    size_t          width;
+    size_t          height;
+    size_t          numPixels;      // items produced per run
+    size_t          numBytes;       // bytes read + written per run
+    double          medianMs;
+    double          p95Ms;
+    double          minMs;
+};
+
+class BenchRunner {
+public:
+    using SetupFunc = std::function<void()>;
+    using RunFunc = std::function<void()>;
+
+    explicit BenchRunner(const BenchOptions& options)
+        : mOptions(options)
+    {
+    }
+
+    // `setup` runs before every repetition and is not timed
+    void Run(const String& name, const size_t width, const size_t height, const size_t numPixels, const size_t numBytes, const SetupFunc& setup, const RunFunc& run) {
+        if (!mOptions.filter.empty() && name.find(mOptions.filter) == String::npos) {
+            return;
+        }
+
+        for (size_t i = 0; i < mOptions.warmup; ++i) {
+            setup();
+            run();
+        }
+
+        Array<double> timesMs(mOptions.reps);
+        for (double& t : timesMs) {
+            setup();
+            const auto start = std::chrono::steady_clock::now();
+            run();
+            t = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::sort(timesMs.begin(), timesMs.end());
+
+        BenchResult result;
+        result.name = name;
+        result.width = width;
+        result.height = height;
+        result.numPixels = numPixels;
+        result.numBytes = numBytes;
+        result.medianMs = (timesMs.size() & 1) ? timesMs[timesMs.size() / 2] : (timesMs[timesMs.size() / 2 - 1] + timesMs[timesMs.size() / 2]) * 0.5;
+        result.p95Ms = timesMs[Minimum((timesMs.size() * 95 + 99) / 100, timesMs.size()) - 1];
+        result.minMs = timesMs.front();
+
+        this->Print(result);
+        mResults.push_back(result);
+    }
+
+    bool WriteJson(const fs::path& path) const {
+        FILE* f = fopen(path.u8string().c_str(), "w");
+        if (!f) {
+            return false;
+        }
+
+        fprintf(f, "{\n  \"concurrency\": %zu,\n  \"reps\": %zu,\n  \"warmup\": %zu,\n  \"benchmarks\": [\n",
+                ThreadPool::Get().GetConcurrency(), mOptions.reps, mOptions.warmup);
+        for (size_t i = 0; i < mResults.size(); ++i) {
+            const BenchResult& r = mResults[i];
+            fprintf(f, "    { \"name\": \"%s\", \"width\": %zu, \"height\": %zu, \"pixels\": %zu, \"bytes\": %zu, "
+                       "\"median_ms\": %.4f, \"p95_ms\": %.4f, \"min_ms\": %.4f, "
+                       "\"ns_per_pixel\": %.4f, \"mpix_per_s\": %.3f, \"gb_per_s\": %.3f }%s\n",
+                    r.name.c_str(), r.width, r.height, r.numPixels, r.numBytes,
+                    r.medianMs, r.p95Ms, r.minMs,
+                    NsPerPixel(r), MegapixelsPerSecond(r), GigabytesPerSecond(r),
+                    (i + 1) < mResults.size() ? "," : "");
+        }
+        fprintf(f, "  ]\n}\n");
+        fclose(f);
+
+        return true;
+    }
+
+    static void PrintHeader() {
+        printf("%-28s %11s %10s %10s %10s %10s %9s\n", "benchmark", "size", "median ms", "p95 ms", "ns/px", "MP/s", "GB/s");
+    }
+
+private:
+    static double NsPerPixel(const BenchResult& r) {
+        return r.numPixels ? (r.medianMs * 1e6) / scast<double>(r.numPixels) : 0.0;
+    }
+    static double MegapixelsPerSecond(const BenchResult& r) {
+        return r.medianMs > 0.0 ? (scast<double>(r.numPixels) / 1e6) / (r.medianMs / 1e3) : 0.0;
+    }
+    static double GigabytesPerSecond(const BenchResult& r) {
+        return r.medianMs > 0.0 ? (scast<double>(r.numBytes) / 1e9) / (r.medianMs / 1e3) : 0.0;
+    }
+
+    void Print(const BenchResult& r) const {
+        const String size = std::to_string(r.width) + "x" + std::to_string(r.height);
+        printf("%-28s %11s %10.3f %10.3f %10.3f %10.1f %9.2f\n", r.name.c_str(), size.c_str(), r.medianMs, r.p95Ms,
+               NsPerPixel(r), MegapixelsPerSecond(r), GigabytesPerSecond(r));
+        fflush(stdout);
+    }
+
+private:
+    const BenchOptions& mOptions;
+    Array<BenchResult>  mResults;
+};
+
+
+// Deterministic HDR content: a smooth sky-ish gradient, a bright "sun" and per-texel hashed noise
+static uint32_t HashTexel(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return x;
+}
+
+static Array<vec3> MakeSyntheticLatLong(const size_t width, const size_t height) {
+    Array<vec3> pixels(width * height);
+
+    ThreadPool::Get().ParallelFor(0, height, 16, [&](const size_t rowBegin, const size_t rowEnd) {
+        for (size_t y = rowBegin; y < rowEnd; ++y) {
+            const float v = (scast<float>(y) + 0.5f) / scast<float>(height);
+            for (size_t x = 0; x < width; ++x) {
+                const float u = (scast<float>(x) + 0.5f) / scast<float>(width);
+                const uint32_t h = HashTexel(scast<uint32_t>(x + y * width));
+                const float noise = scast<float>(h & 0xFFFF) / 65535.0f;
+
+                const float du = u - 0.3f, dv = v - 0.25f;
+                const float sun = 40.0f / (1.0f + 4000.0f * (du * du + dv * dv));
+
+                pixels[x + y * width] = vec3(0.2f + 0.8f * (1.0f - v) + sun,
+                                             0.3f + 0.6f * (1.0f - v) + sun * 0.9f,
+                                             0.4f + 0.5f * v + sun * 0.7f) * (0.9f + 0.2f * noise);
+            }
+        }
+    });
+
+    return pixels;
+}
+
+static Array<vec3> MakeSyntheticDirs(const size_t count) {
+    Array<vec3> dirs(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t h0 = HashTexel(scast<uint32_t>(i * 3 + 0));
+        const uint32_t h1 = HashTexel(scast<uint32_t>(i * 3 + 1));
+        const uint32_t h2 = HashTexel(scast<uint32_t>(i * 3 + 2));
+        const vec3 d = vec3(scast<float>(h0), scast<float>(h1), scast<float>(h2)) / 4294967295.0f * 2.0f - 1.0f;
+        dirs[i] = Normalize(d + vec3(0.0f, 0.0f, 1e-6f));
+    }
+    return dirs;
+}
+
+static void BenchSize(BenchRunner& runner, const BenchOptions& options, const size_t latLongWidth) {
+    const size_t latLongHeight = latLongWidth / 2;
+    const size_t faceSize = latLongWidth / 4;
+    const size_t crossWidth = faceSize * 3;
+    const size_t crossHeight = faceSize * 4;
+
+    const size_t latLongPixels = latLongWidth * latLongHeight;
+    const size_t facesPixels = faceSize * faceSize * EnvironmentImage::kNumCubeFaces;
+    const size_t crossPixels = crossWidth * crossHeight;
+
+    const Array<vec3> latLongPixelsData = MakeSyntheticLatLong(latLongWidth, latLongHeight);
+
+    Array<vec3> crossPixelsData;
+    {
+        EnvironmentImage source;
+        source.CreateLatLong(latLongWidth, latLongHeight, latLongPixelsData.data());
+        const ImageView cross = source.GetCubeCross();
+        crossPixelsData.assign(cross.data, cross.data + cross.width * cross.height);
+    }
+
+    EnvironmentImage img;
+
+    // conversions, cold = the remap table is built as part of the run
+    for (const bool warm : { false, true }) {
+        const String suffix = warm ? "_warm" : "_cold";
+
+        runner.Run("latlong_to_faces" + suffix, latLongWidth, latLongHeight, facesPixels, (latLongPixels + facesPixels) * sizeof(vec3),
+            [&]() {
+                if (!warm) {
+                    RemapTableCache::Get().Clear();
+                }
+                img.CreateLatLong(latLongWidth, latLongHeight, latLongPixelsData.data());
+            },
+            [&]() { img.GetCubeCross(); });
+
+        runner.Run("faces_to_latlong" + suffix, crossWidth, crossHeight, latLongPixels, (facesPixels + latLongPixels) * sizeof(vec3),
+            [&]() {
+                if (!warm) {
+                    RemapTableCache::Get().Clear();
+                }
+                img.CreateCubeCross(crossWidth, crossHeight, crossPixelsData.data());
+            },
+            [&]() { img.GetLatLong(); });
+    }
+
+    // cross <-> faces: the faces are views into the cross, so this is the import copy + view set up,
+    // and packing all the faces out of the cross (what the savers do)
+    runner.Run("cross_to_faces", crossWidth, crossHeight, crossPixels, crossPixels * sizeof(vec3) * 2,
+        [&]() { img.Free(); },
+        [&]() { img.CreateCubeCross(crossWidth, crossHeight, crossPixelsData.data()); });
+
+    {
+        Array<vec3> packedFaces(facesPixels);
+        img.CreateCubeCross(crossWidth, crossHeight, crossPixelsData.data());
+        runner.Run("faces_to_packed", faceSize, faceSize * EnvironmentImage::kNumCubeFaces, facesPixels, facesPixels * sizeof(vec3) * 2,
+            []() {},
+            [&]() {
+                vec3* dst = packedFaces.data();
+                for (size_t i = 0; i < EnvironmentImage::kNumCubeFaces; ++i) {
+                    const ImageView face = img.GetCubeFace(scast<EnvironmentImage::CubeFace>(i));
+                    for (size_t y = 0; y < face.height; ++y) {
+                        const vec3* src = face.RowBegin(y);
+                        const ptrdiff_t step = face.TexelStep();
+                        for (size_t x = 0; x < face.width; ++x, src += step) {
+                            *dst++ = *src;
+                        }
+                    }
+                }
+            });
+    }
+
+    // display formats, the LatLong packed row by row as the texture streaming does it
+    for (const PackedFormat format : { PackedFormat::RGBA16F, PackedFormat::R11G11B10F, PackedFormat::RGB9E5 }) {
+        const size_t texelSize = GetPackedTexelSize(format);
+        BytesArray packed(latLongPixels * texelSize);
+        runner.Run("pack_" + String(GetPackedFormatName(format)), latLongWidth, latLongHeight, latLongPixels, latLongPixels * (sizeof(vec3) + texelSize),
+            []() {},
+            [&]() {
+                ThreadPool::Get().ParallelFor(0, latLongHeight, 16, [&](const size_t rowBegin, const size_t rowEnd) {
+                    for (size_t y = rowBegin; y < rowEnd; ++y) {
+                        PackTexels(latLongPixelsData.data() + y * latLongWidth, 1, packed.data() + y * latLongWidth * texelSize, latLongWidth, format);
+                    }
+                });
+            });
+    }
+
+    // sampling, one bilinear lookup per direction - SampleLatLong is SampleImage2D behind DirToLatLong
+    {
+        const Array<vec3> dirs = MakeSyntheticDirs(sNumSampleDirs);
+        Array<vec3> out(sNumSampleDirs);
+        // direction in, 4 taps, result out
+        const size_t sampleBytes = sNumSampleDirs * sizeof(vec3) * 6;
+
+        img.CreateLatLong(latLongWidth, latLongHeight, latLongPixelsData.data());
+        img.GetCubeCross();
+
+        runner.Run("sample_latlong", latLongWidth, latLongHeight, sNumSampleDirs, sampleBytes, []() {}, [&]() {
+            for (size_t i = 0; i < sNumSampleDirs; ++i) {
+                out[i] = img.SampleLatLong(dirs[i]);
+            }
+        });
+        runner.Run("sample_latlong_batch", latLongWidth, latLongHeight, sNumSampleDirs, sampleBytes, []() {}, [&]() {
+            img.SampleLatLongBatch(dirs.data(), out.data(), sNumSampleDirs);
+        });
+        runner.Run("sample_cube", faceSize, faceSize, sNumSampleDirs, sampleBytes, []() {}, [&]() {
+            for (size_t i = 0; i < sNumSampleDirs; ++i) {
+                out[i] = img.SampleCube(dirs[i]);
+            }
+        });
+        runner.Run("sample_cube_batch", faceSize, faceSize, sNumSampleDirs, sampleBytes, []() {}, [&]() {
+            img.SampleCubeBatch(dirs.data(), out.data(), sNumSampleDirs);
+        });
+    }
+
+    // codecs, LatLong in and out of every supported format
+    std::error_code ec;
+    fs::create_directories(options.tmpFolder, ec);
+    for (const char* extension : sCodecExtensions) {
+        const fs::path path = options.tmpFolder / (String("bench_") + std::to_string(latLongWidth) + extension);
+        const String codec = extension + 1;
+        const size_t ldrBytes = latLongPixels * 3;
+        const size_t fileBytes = (codec == "hdr") ? latLongPixels * 4 : ldrBytes;
+
+        img.CreateLatLong(latLongWidth, latLongHeight, latLongPixelsData.data());
+        runner.Run("save_" + codec, latLongWidth, latLongHeight, latLongPixels, latLongPixels * sizeof(vec3) + fileBytes, []() {}, [&]() {
+            img.SaveLatLong(path);
+        });
+
+        EnvironmentImage loaded;
+        runner.Run("load_" + codec, latLongWidth, latLongHeight, latLongPixels, fileBytes + latLongPixels * sizeof(vec3), []() {}, [&]() {
+            loaded.LoadLatLong(path);
+        });
+
+        fs::remove(path, ec);
+    }
+}
+
+static bool ParseOptions(const int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = (i + 1) < argc;
+
+        if (!strcmp(arg, "--sizes") && hasValue) {
+            options.sizes.clear();
+            for (const char* p = argv[++i]; *p; ) {
+                char* end = nullptr;
+                const size_t size = scast<size_t>(strtoull(p, &end, 10));
+                if (end == p || size < 8 || (size % 4)) {
+                    return false;
+                }
+                options.sizes.push_back(size);
+                p = (*end == ',') ? end + 1 : end;
+            }
+        } else if (!strcmp(arg, "--reps") && hasValue) {
+            options.reps = Maximum(scast<size_t>(strtoull(argv[++i], nullptr, 10)), size_t(1));
+        } else if (!strcmp(arg, "--warmup") && hasValue) {
+            options.warmup = scast<size_t>(strtoull(argv[++i], nullptr, 10));
+        } else if (!strcmp(arg, "--filter") && hasValue) {
+            options.filter = argv[++i];
+        } else if (!strcmp(arg, "--json") && hasValue) {
+            options.jsonPath = fs::u8path(argv[++i]);
+        } else if (!strcmp(arg, "--tmp") && hasValue) {
+            options.tmpFolder = fs::u8path(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: icube_bench [--sizes 2048,4096,8192] [--reps 5] [--warmup 1] [--filter <substring>]\n"
+                        "                   [--json <path>] [--tmp <folder>]\n");
+        return 1;
+    }
+
+    printf("icube_bench: %zu threads, %zu reps, %zu warm-up\n\n", ThreadPool::Get().GetConcurrency(), options.reps, options.warmup);
+
+    BenchRunner runner(options);
+    BenchRunner::PrintHeader();
+    for (const size_t size : options.sizes) {
+        BenchSize(runner, options, size);
+    }
+
+    if (!options.jsonPath.empty() && !runner.WriteJson(options.jsonPath)) {
+        fprintf(stderr, "failed to write %s\n", options.jsonPath.u8string().c_str());
+        return 1;
+    }
+
+    return 0;
+}
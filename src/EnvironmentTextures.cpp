@@ -0,0 +1,266 @@
+#include "EnvironmentTextures.h"
+#include "GLState.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+// Per frame upload budget, the ring holds a few frames worth so the GPU has time to consume a segment
+static const size_t sUploadSegmentBytes = size_t(32) << 20;
+static const size_t sUploadNumSegments = 3;
+// rows packed per worker tile
+static const size_t sPackTileRows = 16;
+
+struct GLTexelFormat {
+    GLenum  internalFormat;
+    GLenum  format;
+    GLenum  type;
+};
+
+static GLTexelFormat GetGLTexelFormat(const PackedFormat format) {
+    switch (format) {
+        case PackedFormat::RGBA16F:     return { GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT };
+        case PackedFormat::R11G11B10F:  return { GL_R11F_G11F_B10F, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV };
+        case PackedFormat::RGB9E5:      return { GL_RGB9_E5, GL_RGB, GL_UNSIGNED_INT_5_9_9_9_REV };
+        default:                        return { GL_RGB32F, GL_RGB, GL_FLOAT };
+    }
+}
+
+
+static void SetupTextureSampler(const GLenum target) {
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+}
+
+// packs `numRows` rows of the view tightly, in view order (takes care of the rotated -Z face)
+static void PackRows(const ImageView& view, const size_t firstRow, const size_t numRows, const PackedFormat format, uint8_t* dst) {
+    const size_t rowBytes = view.width * GetPackedTexelSize(format);
+    ThreadPool::Get().ParallelFor(firstRow, firstRow + numRows, sPackTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+        for (size_t y = rowBegin; y < rowEnd; ++y) {
+            PackTexels(view.RowBegin(y), view.TexelStep(), dst + (y - firstRow) * rowBytes, view.width, format);
+        }
+    });
+}
+
+
+EnvironmentTextures::EnvironmentTextures()
+    : mFormat(PackedFormat::RGB9E5)
+    , mCubeMap(0)
+    , mCubeMapFormat(PackedFormat::RGB9E5)
+    , mFaceWidth(0)
+    , mFaceHeight(0)
+    , mRevision(0)
+    , mCreated(false)
+{
+}
+EnvironmentTextures::~EnvironmentTextures() {
+}
+
+GLuint EnvironmentTextures::GetCubeMap(EnvironmentImage& img) {
+    if (!this->IsUpToDate(img)) {
+        this->CreateCubeMap(img);
+    }
+    return mUploads.empty() ? mCubeMap : 0;
+}
+
+void EnvironmentTextures::Update(const EnvironmentImage& img) {
+    // the views of an older revision may point into freed memory
+    if (!mUploads.empty() && mUploads.front().revision != img.GetRevision()) {
+        mUploads.clear();
+    }
+
+    if (mUploads.empty()) {
+        return;
+    }
+
+    if (!mRing.IsInitialized() && !mRing.Initialize(sUploadSegmentBytes, sUploadNumSegments)) {
+        return;
+    }
+
+    TRACE_ZONE("Stream textures");
+
+    const size_t texelSize = GetPackedTexelSize(mFormat);
+    const GLTexelFormat glFormat = GetGLTexelFormat(mFormat);
+
+    // rows too big for a segment skip the ring
+    const size_t segmentBytes = mRing.GetSegmentBytes();
+    for (size_t i = 0; i < mUploads.size();) {
+        if (mUploads[i].view.width * texelSize > segmentBytes) {
+            this->UploadDirect(mUploads[i]);
+            mUploads.erase(mUploads.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+
+    if (mUploads.empty()) {
+        return;
+    }
+
+    uint8_t* segment = mRing.BeginSegment();
+    if (!segment) {
+        return;
+    }
+
+    struct Chunk {
+        GLenum  target;
+        size_t  width;
+        size_t  firstRow;
+        size_t  numRows;
+        size_t  offset;
+    };
+    Array<Chunk> chunks;
+
+    size_t used = 0;
+    while (!mUploads.empty()) {
+        Upload& upload = mUploads.front();
+
+        const size_t rowBytes = upload.view.width * texelSize;
+        const size_t numRows = Minimum((segmentBytes - used) / rowBytes, upload.view.height - upload.nextRow);
+        if (!numRows) {
+            break;
+        }
+
+        PackRows(upload.view, upload.nextRow, numRows, mFormat, segment + used);
+        chunks.push_back({ upload.target, upload.view.width, upload.nextRow, numRows, used });
+
+        used += numRows * rowBytes;
+        upload.nextRow += numRows;
+
+        if (upload.nextRow == upload.view.height) {
+            mUploads.erase(mUploads.begin());
+        }
+    }
+
+    const size_t segmentOffset = mRing.EndSegment();
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    GLState::Get().BindTexture(GL_TEXTURE_CUBE_MAP, mCubeMap);
+    for (const Chunk& chunk : chunks) {
+        glTexSubImage2D(chunk.target, 0, 0, scast<GLint>(chunk.firstRow), scast<GLsizei>(chunk.width), scast<GLsizei>(chunk.numRows),
+                        glFormat.format, glFormat.type, rcast<const void*>(segmentOffset + chunk.offset));
+    }
+
+    mRing.FenceSegment();
+
+    TRACE_BYTES_WRITTEN(used);
+}
+
+bool EnvironmentTextures::IsUploading() const {
+    return !mUploads.empty();
+}
+
+void EnvironmentTextures::SetFormat(const PackedFormat format) {
+    if (mFormat != format) {
+        mFormat = format;
+
+        // everything is uploaded again on the next request
+        mUploads.clear();
+        mCreated = false;
+    }
+}
+
+PackedFormat EnvironmentTextures::GetFormat() const {
+    return mFormat;
+}
+
+void EnvironmentTextures::Free() {
+    GLState::Get().DeleteTexture(mCubeMap);
+    mFaceWidth = 0;
+    mFaceHeight = 0;
+    mCreated = false;
+
+    mUploads.clear();
+    mRing.Shutdown();
+}
+
+bool EnvironmentTextures::IsUpToDate(const EnvironmentImage& img) {
+    if (mCreated && mRevision == img.GetRevision()) {
+        return true;
+    }
+
+    mUploads.clear();
+
+    // nothing to reuse the texture for
+    if (img.IsEmpty() && mCubeMap) {
+        GLState::Get().DeleteTexture(mCubeMap);
+        mFaceWidth = 0;
+        mFaceHeight = 0;
+    }
+
+    mCreated = true;
+    mRevision = img.GetRevision();
+
+    return false;
+}
+
+void EnvironmentTextures::PrepareTexture(const size_t faceWidth, const size_t faceHeight) {
+    // immutable storage can't be resized, a same sized texture is simply overwritten
+    if (mCubeMap && mFaceWidth == faceWidth && mFaceHeight == faceHeight && mCubeMapFormat == mFormat) {
+        return;
+    }
+
+    GLState::Get().DeleteTexture(mCubeMap);
+
+    glGenTextures(1, &mCubeMap);
+    GLState::Get().BindTexture(GL_TEXTURE_CUBE_MAP, mCubeMap);
+    SetupTextureSampler(GL_TEXTURE_CUBE_MAP);
+    glTexStorage2D(GL_TEXTURE_CUBE_MAP, 1, GetGLTexelFormat(mFormat).internalFormat, scast<GLsizei>(faceWidth), scast<GLsizei>(faceHeight));
+
+    mCubeMapFormat = mFormat;
+    mFaceWidth = faceWidth;
+    mFaceHeight = faceHeight;
+}
+
+void EnvironmentTextures::CreateCubeMap(EnvironmentImage& img) {
+    if (img.IsEmpty()) {
+        return;
+    }
+
+    TRACE_ZONE("Create cube map");
+
+    this->PrepareTexture(img.GetCubeFaceWidth(), img.GetCubeFaceHeight());
+
+    // faces are read straight out of the cross when streamed, the rotated -Z included
+    for (size_t i = 0; i < EnvironmentImage::kNumCubeFaces; ++i) {
+        const ImageView faceView = img.GetCubeFace(scast<EnvironmentImage::CubeFace>(i));
+        this->QueueUpload(GL_TEXTURE_CUBE_MAP_POSITIVE_X + scast<GLenum>(i), faceView, img.GetRevision());
+
+        TRACE_PIXELS(faceView.width * faceView.height);
+    }
+}
+
+void EnvironmentTextures::QueueUpload(const GLenum target, const ImageView& view, const uint32_t revision) {
+    if (view.data && view.width && view.height) {
+        mUploads.push_back({ target, view, 0, revision });
+    }
+}
+
+void EnvironmentTextures::UploadDirect(Upload& upload) {
+    const size_t numRows = upload.view.height - upload.nextRow;
+    const size_t texelSize = GetPackedTexelSize(mFormat);
+    const GLTexelFormat glFormat = GetGLTexelFormat(mFormat);
+
+    TRACE_ZONE("Upload direct");
+    TRACE_BYTES_WRITTEN(upload.view.width * numRows * texelSize);
+
+    BytesArray packed;
+    const void* pixels = nullptr;
+    if (mFormat == PackedFormat::RGB32F && upload.view.IsContiguous()) {
+        pixels = upload.view.RowBegin(upload.nextRow);
+    } else {
+        packed.resize(upload.view.width * numRows * texelSize);
+        PackRows(upload.view, upload.nextRow, numRows, mFormat, packed.data());
+        pixels = packed.data();
+    }
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    GLState::Get().BindTexture(GL_TEXTURE_CUBE_MAP, mCubeMap);
+    glTexSubImage2D(upload.target, 0, 0, scast<GLint>(upload.nextRow), scast<GLsizei>(upload.view.width), scast<GLsizei>(numRows),
+                    glFormat.format, glFormat.type, pixels);
+
+    upload.nextRow = upload.view.height;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "mycommon.h"
+#include "EnvironmentImage.h"
+#include "PixelPacking.h"
+#include "UploadRing.h"
+
+#include "glad/glad.h"
+
+
+// GL side of an EnvironmentImage, kept out of the core so the conversion engine has no GL dependency.
+// Only the cube map lives on the GPU, the LatLong and cross panels are drawn from it by their shaders.
+// It gets immutable storage on first request after the image changed, the faces are then streamed in
+// by Update() through a PBO ring, a few MB per frame, packed to the display format on the worker threads.
+// Call from the GL thread only.
+class EnvironmentTextures {
+public:
+    EnvironmentTextures();
+    ~EnvironmentTextures();
+
+    // 0 until the texture is fully uploaded
+    GLuint  GetCubeMap(EnvironmentImage& img);
+
+    // Once per frame, streams the pending uploads of `img` within the frame budget
+    void    Update(const EnvironmentImage& img);
+    bool    IsUploading() const;
+
+    // Texel format of the texture, RGB32F keeps the exact pixels, the rest trade precision for VRAM and upload time
+    void    SetFormat(const PackedFormat format);
+    PackedFormat GetFormat() const;
+
+    void    Free();
+
+private:
+    // rows of one cube map face left to stream into the texture
+    struct Upload {
+        GLenum      target;
+        ImageView   view;
+        size_t      nextRow;
+        uint32_t    revision;       // of the image the view points into
+    };
+
+    // true if the texture is up to date with the image, otherwise drops the pending uploads
+    bool    IsUpToDate(const EnvironmentImage& img);
+    // (re)allocates the storage, the texture is kept if the size didn't change
+    void    PrepareTexture(const size_t faceWidth, const size_t faceHeight);
+
+    void    CreateCubeMap(EnvironmentImage& img);
+
+    void    QueueUpload(const GLenum target, const ImageView& view, const uint32_t revision);
+    // for rows too big for a ring segment
+    void    UploadDirect(Upload& upload);
+
+private:
+    PackedFormat    mFormat;
+
+    GLuint          mCubeMap;
+    PackedFormat    mCubeMapFormat;
+    size_t          mFaceWidth;
+    size_t          mFaceHeight;
+    uint32_t        mRevision;
+    bool            mCreated;
+
+    Array<Upload>   mUploads;
+    UploadRing      mRing;
+};
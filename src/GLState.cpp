@@ -0,0 +1,307 @@
+#include "GLState.h"
+
+static const GLuint kUnknownName = ~0u;
+static const GLenum kUnknownEnum = ~0u;
+
+
+GLState& GLState::Get() {
+    static GLState sState;
+    return sState;
+}
+
+GLState::GLState() {
+    this->Invalidate();
+}
+
+void GLState::Invalidate() {
+    mValues.program = kUnknownName;
+    mValues.activeTexture = kUnknownEnum;
+    for (size_t i = 0; i < kNumTextureUnits; ++i) {
+        mValues.textures2D[i] = kUnknownName;
+        mValues.texturesCube[i] = kUnknownName;
+        mValues.samplers[i] = kUnknownName;
+    }
+    mValues.vertexArray = kUnknownName;
+    mValues.arrayBuffer = kUnknownName;
+    mValues.framebuffer = kUnknownName;
+    mValues.blend = -1;
+    mValues.cullFace = -1;
+    mValues.depthTest = -1;
+    mValues.scissorTest = -1;
+    mValues.blendEquation[0] = mValues.blendEquation[1] = kUnknownEnum;
+    mValues.blendFunc[0] = mValues.blendFunc[1] = mValues.blendFunc[2] = mValues.blendFunc[3] = kUnknownEnum;
+    mValues.depthFunc = kUnknownEnum;
+    mValues.polygonMode = kUnknownEnum;
+    mValues.hasViewport = false;
+    mValues.hasScissor = false;
+}
+
+const GLState::Values& GLState::GetValues() const {
+    return mValues;
+}
+
+void GLState::Restore(const Values& values) {
+    if (values.program != kUnknownName) {
+        this->UseProgram(values.program);
+    }
+
+    // the bindings first, they go to the active unit
+    for (size_t i = 0; i < kNumTextureUnits; ++i) {
+        const bool has2D = values.textures2D[i] != kUnknownName && values.textures2D[i] != mValues.textures2D[i];
+        const bool hasCube = values.texturesCube[i] != kUnknownName && values.texturesCube[i] != mValues.texturesCube[i];
+        if (has2D || hasCube) {
+            this->ActiveTexture(GL_TEXTURE0 + scast<GLenum>(i));
+            if (has2D) {
+                this->BindTexture(GL_TEXTURE_2D, values.textures2D[i]);
+            }
+            if (hasCube) {
+                this->BindTexture(GL_TEXTURE_CUBE_MAP, values.texturesCube[i]);
+            }
+        }
+        if (values.samplers[i] != kUnknownName) {
+            this->BindSampler(scast<GLuint>(i), values.samplers[i]);
+        }
+    }
+    if (values.activeTexture != kUnknownEnum) {
+        this->ActiveTexture(values.activeTexture);
+    }
+
+    if (values.vertexArray != kUnknownName) {
+        this->BindVertexArray(values.vertexArray);
+    }
+    if (values.arrayBuffer != kUnknownName) {
+        this->BindBuffer(GL_ARRAY_BUFFER, values.arrayBuffer);
+    }
+    if (values.framebuffer != kUnknownName) {
+        this->BindFramebuffer(values.framebuffer);
+    }
+
+    if (values.blend >= 0) {
+        this->SetEnabled(GL_BLEND, values.blend != 0);
+    }
+    if (values.cullFace >= 0) {
+        this->SetEnabled(GL_CULL_FACE, values.cullFace != 0);
+    }
+    if (values.depthTest >= 0) {
+        this->SetEnabled(GL_DEPTH_TEST, values.depthTest != 0);
+    }
+    if (values.scissorTest >= 0) {
+        this->SetEnabled(GL_SCISSOR_TEST, values.scissorTest != 0);
+    }
+
+    if (values.blendEquation[0] != kUnknownEnum) {
+        this->BlendEquation(values.blendEquation[0], values.blendEquation[1]);
+    }
+    if (values.blendFunc[0] != kUnknownEnum) {
+        this->BlendFunc(values.blendFunc[0], values.blendFunc[1], values.blendFunc[2], values.blendFunc[3]);
+    }
+    if (values.depthFunc != kUnknownEnum) {
+        this->DepthFunc(values.depthFunc);
+    }
+    if (values.polygonMode != kUnknownEnum) {
+        this->PolygonMode(values.polygonMode);
+    }
+    if (values.hasViewport) {
+        this->Viewport(values.viewport[0], values.viewport[1], values.viewport[2], values.viewport[3]);
+    }
+    if (values.hasScissor) {
+        this->Scissor(values.scissor[0], values.scissor[1], values.scissor[2], values.scissor[3]);
+    }
+}
+
+void GLState::UseProgram(const GLuint program) {
+    if (mValues.program != program) {
+        glUseProgram(program);
+        mValues.program = program;
+    }
+}
+
+void GLState::ActiveTexture(const GLenum unit) {
+    if (mValues.activeTexture != unit) {
+        glActiveTexture(unit);
+        mValues.activeTexture = unit;
+    }
+}
+
+void GLState::BindTexture(const GLenum target, const GLuint texture) {
+    GLuint* binding = this->GetTextureBinding(target);
+    if (!binding) {
+        glBindTexture(target, texture);
+
+        // some unit's binding changed, we can't tell which one
+        if (mValues.activeTexture == kUnknownEnum && (target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP)) {
+            for (size_t i = 0; i < kNumTextureUnits; ++i) {
+                mValues.textures2D[i] = kUnknownName;
+                mValues.texturesCube[i] = kUnknownName;
+            }
+        }
+    } else if (*binding != texture) {
+        glBindTexture(target, texture);
+        *binding = texture;
+    }
+}
+
+void GLState::BindSampler(const GLuint unit, const GLuint sampler) {
+    if (unit >= kNumTextureUnits) {
+        glBindSampler(unit, sampler);
+    } else if (mValues.samplers[unit] != sampler) {
+        glBindSampler(unit, sampler);
+        mValues.samplers[unit] = sampler;
+    }
+}
+
+void GLState::BindVertexArray(const GLuint vertexArray) {
+    if (mValues.vertexArray != vertexArray) {
+        glBindVertexArray(vertexArray);
+        mValues.vertexArray = vertexArray;
+    }
+}
+
+void GLState::BindBuffer(const GLenum target, const GLuint buffer) {
+    // the element array binding is part of the vertex array, the rest we don't track
+    if (target != GL_ARRAY_BUFFER) {
+        glBindBuffer(target, buffer);
+    } else if (mValues.arrayBuffer != buffer) {
+        glBindBuffer(target, buffer);
+        mValues.arrayBuffer = buffer;
+    }
+}
+
+void GLState::BindFramebuffer(const GLuint framebuffer) {
+    if (mValues.framebuffer != framebuffer) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        mValues.framebuffer = framebuffer;
+    }
+}
+
+void GLState::SetEnabled(const GLenum cap, const bool enabled) {
+    int8_t* state = this->GetEnabledState(cap);
+    if (!state || *state != scast<int8_t>(enabled)) {
+        if (enabled) {
+            glEnable(cap);
+        } else {
+            glDisable(cap);
+        }
+        if (state) {
+            *state = scast<int8_t>(enabled);
+        }
+    }
+}
+
+void GLState::BlendEquation(const GLenum rgb, const GLenum alpha) {
+    if (mValues.blendEquation[0] != rgb || mValues.blendEquation[1] != alpha) {
+        glBlendEquationSeparate(rgb, alpha);
+        mValues.blendEquation[0] = rgb;
+        mValues.blendEquation[1] = alpha;
+    }
+}
+
+void GLState::BlendFunc(const GLenum srcRgb, const GLenum dstRgb, const GLenum srcAlpha, const GLenum dstAlpha) {
+    if (mValues.blendFunc[0] != srcRgb || mValues.blendFunc[1] != dstRgb || mValues.blendFunc[2] != srcAlpha || mValues.blendFunc[3] != dstAlpha) {
+        glBlendFuncSeparate(srcRgb, dstRgb, srcAlpha, dstAlpha);
+        mValues.blendFunc[0] = srcRgb;
+        mValues.blendFunc[1] = dstRgb;
+        mValues.blendFunc[2] = srcAlpha;
+        mValues.blendFunc[3] = dstAlpha;
+    }
+}
+
+void GLState::DepthFunc(const GLenum func) {
+    if (mValues.depthFunc != func) {
+        glDepthFunc(func);
+        mValues.depthFunc = func;
+    }
+}
+
+void GLState::PolygonMode(const GLenum mode) {
+    if (mValues.polygonMode != mode) {
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+        mValues.polygonMode = mode;
+    }
+}
+
+void GLState::Viewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height) {
+    GLint* v = mValues.viewport;
+    if (!mValues.hasViewport || v[0] != x || v[1] != y || v[2] != width || v[3] != height) {
+        glViewport(x, y, width, height);
+        v[0] = x; v[1] = y; v[2] = width; v[3] = height;
+        mValues.hasViewport = true;
+    }
+}
+
+void GLState::Scissor(const GLint x, const GLint y, const GLsizei width, const GLsizei height) {
+    GLint* s = mValues.scissor;
+    if (!mValues.hasScissor || s[0] != x || s[1] != y || s[2] != width || s[3] != height) {
+        glScissor(x, y, width, height);
+        s[0] = x; s[1] = y; s[2] = width; s[3] = height;
+        mValues.hasScissor = true;
+    }
+}
+
+void GLState::DeleteTexture(GLuint& texture) {
+    if (texture) {
+        glDeleteTextures(1, &texture);
+        for (size_t i = 0; i < kNumTextureUnits; ++i) {
+            if (mValues.textures2D[i] == texture) {
+                mValues.textures2D[i] = 0;
+            }
+            if (mValues.texturesCube[i] == texture) {
+                mValues.texturesCube[i] = 0;
+            }
+        }
+        texture = 0;
+    }
+}
+
+void GLState::DeleteVertexArray(GLuint& vertexArray) {
+    if (vertexArray) {
+        glDeleteVertexArrays(1, &vertexArray);
+        if (mValues.vertexArray == vertexArray) {
+            mValues.vertexArray = 0;
+        }
+        vertexArray = 0;
+    }
+}
+
+void GLState::DeleteBuffer(GLuint& buffer) {
+    if (buffer) {
+        glDeleteBuffers(1, &buffer);
+        if (mValues.arrayBuffer == buffer) {
+            mValues.arrayBuffer = 0;
+        }
+        buffer = 0;
+    }
+}
+
+void GLState::DeleteFramebuffer(GLuint& framebuffer) {
+    if (framebuffer) {
+        glDeleteFramebuffers(1, &framebuffer);
+        if (mValues.framebuffer == framebuffer) {
+            mValues.framebuffer = 0;
+        }
+        framebuffer = 0;
+    }
+}
+
+int8_t* GLState::GetEnabledState(const GLenum cap) {
+    switch (cap) {
+        case GL_BLEND:          return &mValues.blend;
+        case GL_CULL_FACE:      return &mValues.cullFace;
+        case GL_DEPTH_TEST:     return &mValues.depthTest;
+        case GL_SCISSOR_TEST:   return &mValues.scissorTest;
+        default:                return nullptr;
+    }
+}
+
+GLuint* GLState::GetTextureBinding(const GLenum target) {
+    const size_t unit = scast<size_t>(mValues.activeTexture - GL_TEXTURE0);
+    if (mValues.activeTexture == kUnknownEnum || unit >= kNumTextureUnits) {
+        return nullptr;
+    }
+
+    switch (target) {
+        case GL_TEXTURE_2D:         return &mValues.textures2D[unit];
+        case GL_TEXTURE_CUBE_MAP:   return &mValues.texturesCube[unit];
+        default:                    return nullptr;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "mycommon.h"
+
+#include "glad/glad.h"
+
+
+// Shadow copy of the GL state the app and the ImGui backend touch. Changes go through here so redundant
+// ones are skipped, and code that saves / restores state reads the copy instead of glGet* (a sync point
+// on some drivers). That only holds if every change of the tracked state goes through it, deleting a
+// bound object included (GL reverts its bindings to 0). Untracked targets / caps are passed through.
+// Call from the GL thread only.
+class GLState {
+public:
+    static const size_t kNumTextureUnits = 8;
+
+    struct Values {
+        GLuint  program;
+        GLenum  activeTexture;
+        GLuint  textures2D[kNumTextureUnits];
+        GLuint  texturesCube[kNumTextureUnits];
+        GLuint  samplers[kNumTextureUnits];
+        GLuint  vertexArray;
+        GLuint  arrayBuffer;
+        GLuint  framebuffer;
+        int8_t  blend;          // -1 while unknown
+        int8_t  cullFace;
+        int8_t  depthTest;
+        int8_t  scissorTest;
+        GLenum  blendEquation[2];   // rgb, alpha
+        GLenum  blendFunc[4];       // src rgb, dst rgb, src alpha, dst alpha
+        GLenum  depthFunc;
+        GLenum  polygonMode;
+        GLint   viewport[4];
+        GLint   scissor[4];
+        bool    hasViewport;
+        bool    hasScissor;
+    };
+
+    static GLState& Get();
+
+    // Forgets everything, the next change of each state is always issued
+    void    Invalidate();
+
+    // Cached values for a later Restore(), unknown states are left alone on restore
+    const Values& GetValues() const;
+    void    Restore(const Values& values);
+
+    void    UseProgram(const GLuint program);
+    void    ActiveTexture(const GLenum unit);
+    // on the active unit
+    void    BindTexture(const GLenum target, const GLuint texture);
+    void    BindSampler(const GLuint unit, const GLuint sampler);
+    void    BindVertexArray(const GLuint vertexArray);
+    void    BindBuffer(const GLenum target, const GLuint buffer);
+    void    BindFramebuffer(const GLuint framebuffer);
+
+    void    SetEnabled(const GLenum cap, const bool enabled);
+    void    BlendEquation(const GLenum rgb, const GLenum alpha);
+    void    BlendFunc(const GLenum srcRgb, const GLenum dstRgb, const GLenum srcAlpha, const GLenum dstAlpha);
+    void    DepthFunc(const GLenum func);
+    void    PolygonMode(const GLenum mode);
+    void    Viewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height);
+    void    Scissor(const GLint x, const GLint y, const GLsizei width, const GLsizei height);
+
+    void    DeleteTexture(GLuint& texture);
+    void    DeleteVertexArray(GLuint& vertexArray);
+    void    DeleteBuffer(GLuint& buffer);
+    void    DeleteFramebuffer(GLuint& framebuffer);
+
+private:
+    GLState();
+
+    // nullptr for the caps not tracked
+    int8_t* GetEnabledState(const GLenum cap);
+    // nullptr if the active unit isn't known or tracked
+    GLuint* GetTextureBinding(const GLenum target);
+
+private:
+    Values  mValues;
+};
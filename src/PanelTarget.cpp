@@ -0,0 +1,106 @@
+#include "PanelTarget.h"
+#include "GLState.h"
+
+
+PanelTarget::PanelTarget()
+    : mFramebuffer(0)
+    , mColour(0)
+    , mDepth(0)
+    , mWidth(0)
+    , mHeight(0)
+    , mView()
+    , mRendered(false)
+{
+}
+PanelTarget::~PanelTarget() {
+}
+
+void PanelTarget::Shutdown() {
+    GLState::Get().DeleteFramebuffer(mFramebuffer);
+    GLState::Get().DeleteTexture(mColour);
+    if (mDepth) {
+        glDeleteRenderbuffers(1, &mDepth);
+        mDepth = 0;
+    }
+
+    mWidth = 0;
+    mHeight = 0;
+    mRendered = false;
+}
+
+bool PanelTarget::IsCurrent(const size_t width, const size_t height, const PanelView& view) const {
+    return mRendered && mWidth == width && mHeight == height && mView == view;
+}
+
+bool PanelTarget::Begin(const size_t width, const size_t height) {
+    mRendered = false;
+
+    if (!width || !height || !this->Resize(width, height)) {
+        return false;
+    }
+
+    GLState& state = GLState::Get();
+    state.BindFramebuffer(mFramebuffer);
+    state.Viewport(0, 0, scast<GLsizei>(width), scast<GLsizei>(height));
+
+    // transparent where nothing is drawn, the panel background shows through
+    state.SetEnabled(GL_SCISSOR_TEST, false);
+    glDepthMask(GL_TRUE);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClearDepthf(1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    return true;
+}
+
+void PanelTarget::End(const PanelView& view) {
+    GLState::Get().BindFramebuffer(0);
+
+    mView = view;
+    mRendered = true;
+}
+
+GLuint PanelTarget::GetTexture() const {
+    return mRendered ? mColour : 0;
+}
+
+bool PanelTarget::Resize(const size_t width, const size_t height) {
+    if (mFramebuffer && mWidth == width && mHeight == height) {
+        return true;
+    }
+
+    this->Shutdown();
+
+    // same format as the window's back buffer the panels used to be drawn into
+    GLState& state = GLState::Get();
+
+    glGenTextures(1, &mColour);
+    state.BindTexture(GL_TEXTURE_2D, mColour);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, scast<GLsizei>(width), scast<GLsizei>(height));
+
+    glGenRenderbuffers(1, &mDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, mDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, scast<GLsizei>(width), scast<GLsizei>(height));
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &mFramebuffer);
+    state.BindFramebuffer(mFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mColour, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepth);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    state.BindFramebuffer(0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        this->Shutdown();
+        return false;
+    }
+
+    mWidth = width;
+    mHeight = height;
+
+    return true;
+}
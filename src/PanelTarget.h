@@ -0,0 +1,50 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+
+#include "glad/glad.h"
+
+
+// What a cached panel render depends on, the panel is rendered again only when any of it changes
+struct PanelView {
+    vec2        rotation;
+    GLuint      cubeMap;
+    uint32_t    revision;   // of the image in the cube map
+    int         format;     // of the cube map, a new texture may get the old name
+
+    bool operator ==(const PanelView& other) const {
+        return rotation == other.rotation && cubeMap == other.cubeMap && revision == other.revision && format == other.format;
+    }
+};
+
+// Offscreen colour + depth target a 3D panel is rendered into, ImGui then just draws its texture.
+// Call from the GL thread only.
+class PanelTarget {
+public:
+    PanelTarget();
+    ~PanelTarget();
+
+    void        Shutdown();
+
+    // true if the last render was `width` x `height` pixels of `view`
+    bool        IsCurrent(const size_t width, const size_t height, const PanelView& view) const;
+
+    // (Re)allocates the attachments if the size changed, binds the framebuffer, sets the viewport and clears
+    bool        Begin(const size_t width, const size_t height);
+    // Binds the default framebuffer back and remembers what was rendered
+    void        End(const PanelView& view);
+
+    GLuint      GetTexture() const;
+
+private:
+    bool        Resize(const size_t width, const size_t height);
+
+private:
+    GLuint      mFramebuffer;
+    GLuint      mColour;
+    GLuint      mDepth;
+    size_t      mWidth;
+    size_t      mHeight;
+    PanelView   mView;
+    bool        mRendered;
+};
@@ -0,0 +1,100 @@
+#include "UploadRing.h"
+#include "GLState.h"
+
+
+UploadRing::UploadRing()
+    : mBuffer(0)
+    , mTarget(GL_PIXEL_UNPACK_BUFFER)
+    , mSegmentBytes(0)
+    , mCurrent(0)
+{
+}
+UploadRing::~UploadRing() {
+}
+
+bool UploadRing::Initialize(const size_t segmentBytes, const size_t numSegments, const GLenum target) {
+    this->Shutdown();
+
+    glGenBuffers(1, &mBuffer);
+    if (!mBuffer) {
+        return false;
+    }
+
+    GLState& state = GLState::Get();
+    state.BindBuffer(target, mBuffer);
+    glBufferData(target, scast<GLsizeiptr>(segmentBytes * numSegments), nullptr, GL_STREAM_DRAW);
+    state.BindBuffer(target, 0);
+
+    mTarget = target;
+    mSegmentBytes = segmentBytes;
+    mFences.assign(numSegments, nullptr);
+    mCurrent = 0;
+
+    return true;
+}
+
+void UploadRing::Shutdown() {
+    for (GLsync& fence : mFences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    mFences.clear();
+
+    GLState::Get().DeleteBuffer(mBuffer);
+
+    mSegmentBytes = 0;
+    mCurrent = 0;
+}
+
+bool UploadRing::IsInitialized() const {
+    return mBuffer != 0;
+}
+
+GLuint UploadRing::GetBuffer() const {
+    return mBuffer;
+}
+
+size_t UploadRing::GetSegmentBytes() const {
+    return mSegmentBytes;
+}
+
+uint8_t* UploadRing::BeginSegment(const bool wait) {
+    GLsync& fence = mFences[mCurrent];
+    if (fence) {
+        // a busy segment means the GPU is behind, unless told to wait the upload can be done next frame
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        while (wait && status == GL_TIMEOUT_EXPIRED) {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+            return nullptr;
+        }
+
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+
+    GLState::Get().BindBuffer(mTarget, mBuffer);
+    void* ptr = glMapBufferRange(mTarget, scast<GLintptr>(mCurrent * mSegmentBytes), scast<GLsizeiptr>(mSegmentBytes), access);
+    if (!ptr) {
+        GLState::Get().BindBuffer(mTarget, 0);
+    }
+
+    return scast<uint8_t*>(ptr);
+}
+
+size_t UploadRing::EndSegment() {
+    glUnmapBuffer(mTarget);
+    return mCurrent * mSegmentBytes;
+}
+
+void UploadRing::FenceSegment() {
+    mFences[mCurrent] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mCurrent = (mCurrent + 1) % mFences.size();
+
+    GLState::Get().BindBuffer(mTarget, 0);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "mycommon.h"
+
+#include "glad/glad.h"
+
+
+// Streaming buffer split into segments that are filled in turn, one segment per frame.
+// A segment is reused only once the GPU is done reading it (fenced), so filling never stalls the driver.
+// The GL we load is 4.3 (no glBufferStorage), segments are mapped unsynchronized instead of persistently.
+// Pixel unpack buffer for texture uploads by default, the ImGui backend streams its vertices / indices through one too.
+class UploadRing {
+public:
+    UploadRing();
+    ~UploadRing();
+
+    bool        Initialize(const size_t segmentBytes, const size_t numSegments, const GLenum target = GL_PIXEL_UNPACK_BUFFER);
+    void        Shutdown();
+    bool        IsInitialized() const;
+
+    GLuint      GetBuffer() const;
+    size_t      GetSegmentBytes() const;
+
+    // Maps the next segment for writing, nullptr if the GPU still reads from it (try again next frame)
+    // unless `wait`, then it blocks until the segment is free
+    uint8_t*    BeginSegment(const bool wait = false);
+    // Unmaps the segment and leaves the ring bound to its target,
+    // returns the segment's offset in the buffer to use as the "pixels" / "indices" pointer
+    size_t      EndSegment();
+    // After the commands reading the segment were issued, unbinds the ring
+    void        FenceSegment();
+
+private:
+    GLuint          mBuffer;
+    GLenum          mTarget;
+    size_t          mSegmentBytes;
+    Array<GLsync>   mFences;
+    size_t          mCurrent;
+};
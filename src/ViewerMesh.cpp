@@ -0,0 +1,354 @@
+#include "ViewerMesh.h"
+#include "AtomicFile.h"
+#include "Trace.h"
+
+#include <cstring>
+#include <fstream>
+
+static const uint32_t sMeshFileMagic = 0x4D564349;  // 'ICVM'
+static const uint32_t sMeshFileVersion = 1;
+
+// Forsyth's scoring, tuned for a cache of this many entries
+static const size_t sCacheSize = 32;
+static const float  sCacheDecayPower = 1.5f;
+static const float  sLastTriScore = 0.75f;
+static const float  sValenceBoostScale = 2.0f;
+static const float  sValenceBoostPower = 0.5f;
+
+
+static float SignPower(const float v, const float n) {
+    if (v >= 0.0f) {
+        return std::powf(v, n);
+    } else {
+        return -std::powf(-v, n);
+    }
+}
+
+void GenerateRoundedCube(const size_t resolution, const float power, ViewerMesh& mesh) {
+    TRACE_ZONE("GenerateRoundedCube");
+
+    const size_t numRows = resolution / 2 + 1;
+    const size_t numColumns = resolution + 1;
+
+    const float invRes = 1.0f / scast<float>(resolution);
+    const float invHalfRes = 1.0f / scast<float>(resolution / 2);
+
+    // the shape is separable, the powers are only needed per row and per column
+    Array<float> cosPhi(numRows), sinPhi(numRows);
+    for (size_t j = 0; j < numRows; ++j) {
+        const float phi = -MM_HalfPi + MM_Pi * scast<float>(j) * invHalfRes;
+        cosPhi[j] = SignPower(std::cosf(phi), power);
+        sinPhi[j] = SignPower(std::sinf(phi), power);
+    }
+    Array<float> cosTheta(numColumns), sinTheta(numColumns);
+    for (size_t i = 0; i < numColumns; ++i) {
+        const float theta = scast<float>(i) * MM_TwoPi * invRes;
+        cosTheta[i] = SignPower(std::cosf(theta), power);
+        sinTheta[i] = SignPower(std::sinf(theta), power);
+    }
+
+    mesh.resolution = resolution;
+    mesh.vertices.resize(numColumns * numRows);
+    vec3* vb = mesh.vertices.data();
+
+    // Pole is along the z axis
+    for (size_t j = 0; j < numRows; ++j) {
+        for (size_t i = 0; i < numColumns; ++i) {
+            vec3& pos = vb[j * numColumns + i];
+
+            pos.x = cosPhi[j] * cosTheta[i];
+            pos.y = cosPhi[j] * sinTheta[i];
+            pos.z = sinPhi[j];
+
+            // seams
+            if (j == 0) {
+                pos = vec3(0.0f, 0.0f, -1.0f);
+            }
+            if (j == numRows - 1) {
+                pos = vec3(0.0f, 0.0f, 1.0f);
+            }
+            if (i == resolution) {
+                pos.x = vb[j * numColumns].x;
+                pos.y = vb[j * numColumns].y;
+            }
+        }
+    }
+
+    mesh.indices.resize(resolution * (numRows - 1) * 6);
+    uint32_t* ib = mesh.indices.data();
+    for (size_t j = 0; j + 1 < numRows; ++j) {
+        for (size_t i = 0; i < resolution; ++i, ib += 6) {
+            const uint32_t a = scast<uint32_t>(j * numColumns + i);
+            const uint32_t b = scast<uint32_t>(j * numColumns + (i + 1));
+            const uint32_t c = scast<uint32_t>((j + 1) * numColumns + (i + 1));
+            const uint32_t d = scast<uint32_t>((j + 1) * numColumns + i);
+
+            ib[0] = a; ib[1] = b; ib[2] = c;
+            ib[3] = a; ib[4] = c; ib[5] = d;
+        }
+    }
+}
+
+
+static float GetVertexScore(const int cachePosition, const uint32_t numRemainingTris) {
+    if (!numRemainingTris) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // the last triangle's vertices, fixed score so the strip doesn't just turn back
+            score = sLastTriScore;
+        } else {
+            const float scale = 1.0f / scast<float>(sCacheSize - 3);
+            score = std::powf(1.0f - scast<float>(cachePosition - 3) * scale, sCacheDecayPower);
+        }
+    }
+
+    // vertices with few triangles left get a boost, so they're finished off and don't linger
+    score += sValenceBoostScale * std::powf(scast<float>(numRemainingTris), -sValenceBoostPower);
+    return score;
+}
+
+static void OptimizeVertexCache(Array<uint32_t>& indices, const size_t numVertices) {
+    const size_t numTris = indices.size() / 3;
+    if (!numTris) {
+        return;
+    }
+
+    // triangles of each vertex
+    Array<uint32_t> triOffsets(numVertices + 1, 0);
+    for (const uint32_t v : indices) {
+        ++triOffsets[v + 1];
+    }
+    for (size_t v = 0; v < numVertices; ++v) {
+        triOffsets[v + 1] += triOffsets[v];
+    }
+    Array<uint32_t> vertexTris(indices.size());
+    Array<uint32_t> numRemaining(numVertices, 0);
+    for (size_t t = 0; t < numTris; ++t) {
+        for (size_t k = 0; k < 3; ++k) {
+            const uint32_t v = indices[t * 3 + k];
+            vertexTris[triOffsets[v] + numRemaining[v]++] = scast<uint32_t>(t);
+        }
+    }
+
+    Array<int> cachePosition(numVertices, -1);
+    Array<float> vertexScore(numVertices);
+    for (size_t v = 0; v < numVertices; ++v) {
+        vertexScore[v] = GetVertexScore(-1, numRemaining[v]);
+    }
+
+    Array<float> triScore(numTris);
+    Array<bool> triAdded(numTris, false);
+    for (size_t t = 0; t < numTris; ++t) {
+        triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    // +3 so the vertices pushed out by the new triangle can still be rescored
+    uint32_t cache[sCacheSize + 3];
+    size_t cacheCount = 0;
+
+    Array<uint32_t> result;
+    result.reserve(indices.size());
+
+    size_t scanCursor = 0;
+    size_t bestTri = 0;
+    float bestScore = triScore[0];
+    for (size_t t = 1; t < numTris; ++t) {
+        if (triScore[t] > bestScore) {
+            bestScore = triScore[t];
+            bestTri = t;
+        }
+    }
+
+    for (size_t added = 0; added < numTris; ++added) {
+        const uint32_t* tri = &indices[bestTri * 3];
+        result.insert(result.end(), tri, tri + 3);
+        triAdded[bestTri] = true;
+
+        // the triangle's vertices go to the front of the cache, the rest shift back
+        uint32_t newCache[sCacheSize + 3];
+        size_t newCount = 0;
+        for (size_t k = 0; k < 3; ++k) {
+            const uint32_t v = tri[k];
+            newCache[newCount++] = v;
+
+            // drop the triangle from the vertex's remaining ones
+            uint32_t* tris = &vertexTris[triOffsets[v]];
+            for (uint32_t r = 0; r < numRemaining[v]; ++r) {
+                if (tris[r] == bestTri) {
+                    tris[r] = tris[--numRemaining[v]];
+                    break;
+                }
+            }
+        }
+        for (size_t c = 0; c < cacheCount; ++c) {
+            const uint32_t v = cache[c];
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                newCache[newCount++] = v;
+            }
+        }
+
+        // rescore the vertices that are (or just were) in the cache, and their triangles
+        for (size_t c = 0; c < newCount; ++c) {
+            const uint32_t v = newCache[c];
+            cachePosition[v] = c < sCacheSize ? scast<int>(c) : -1;
+            vertexScore[v] = GetVertexScore(cachePosition[v], numRemaining[v]);
+        }
+
+        bestScore = -1.0f;
+        for (size_t c = 0; c < newCount; ++c) {
+            const uint32_t v = newCache[c];
+            const uint32_t* tris = &vertexTris[triOffsets[v]];
+            for (uint32_t r = 0; r < numRemaining[v]; ++r) {
+                const uint32_t t = tris[r];
+                triScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                if (triScore[t] > bestScore) {
+                    bestScore = triScore[t];
+                    bestTri = t;
+                }
+            }
+        }
+
+        cacheCount = Minimum(newCount, sCacheSize);
+        std::copy(newCache, newCache + cacheCount, cache);
+
+        // nothing adjacent to the cache left, continue with the next triangle not added yet
+        if (bestScore < 0.0f) {
+            while (scanCursor < numTris && triAdded[scanCursor]) {
+                ++scanCursor;
+            }
+            bestTri = scanCursor;
+        }
+    }
+
+    indices.swap(result);
+}
+
+static void OptimizeVertexFetch(ViewerMesh& mesh) {
+    Array<uint32_t> remap(mesh.vertices.size(), kInvalidValue32);
+    Array<vec3> vertices;
+    vertices.reserve(mesh.vertices.size());
+
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == kInvalidValue32) {
+            remap[index] = scast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    mesh.vertices.swap(vertices);
+}
+
+void OptimizeViewerMesh(ViewerMesh& mesh) {
+    TRACE_ZONE("OptimizeViewerMesh");
+
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    OptimizeVertexFetch(mesh);
+}
+
+float GetMeshACMR(const Array<uint32_t>& indices, const size_t cacheSize) {
+    if (indices.size() < 3 || !cacheSize) {
+        return 3.0f;
+    }
+
+    Array<uint32_t> fifo(cacheSize, kInvalidValue32);
+    size_t head = 0;
+    size_t misses = 0;
+    for (const uint32_t v : indices) {
+        if (std::find(fifo.begin(), fifo.end(), v) == fifo.end()) {
+            fifo[head] = v;
+            head = (head + 1) % cacheSize;
+            ++misses;
+        }
+    }
+
+    return scast<float>(misses) / scast<float>(indices.size() / 3);
+}
+
+
+bool SaveViewerMeshes(const fs::path& path, const float power, const Array<ViewerMesh>& lods) {
+    uint32_t powerBits = 0;
+    std::memcpy(&powerBits, &power, sizeof(powerBits));
+
+    const uint32_t header[] = {
+        sMeshFileMagic,
+        sMeshFileVersion,
+        powerBits,
+        scast<uint32_t>(lods.size())
+    };
+
+    // the cache sits in the shared temp folder, another instance may be reading or writing it too
+    return WriteFileAtomic(path, [&](std::ofstream& file) {
+        file.write(rcast<const char*>(header), sizeof(header));
+
+        for (const ViewerMesh& mesh : lods) {
+            const uint32_t lodHeader[] = {
+                scast<uint32_t>(mesh.resolution),
+                scast<uint32_t>(mesh.vertices.size()),
+                scast<uint32_t>(mesh.indices.size())
+            };
+            file.write(rcast<const char*>(lodHeader), sizeof(lodHeader));
+            file.write(rcast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(vec3));
+            file.write(rcast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+        }
+
+        return file.good();
+    });
+}
+
+bool LoadViewerMeshes(const fs::path& path, const Array<size_t>& resolutions, const float power, Array<ViewerMesh>& lods) {
+    TRACE_ZONE("LoadViewerMeshes");
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    uint32_t powerBits = 0;
+    std::memcpy(&powerBits, &power, sizeof(powerBits));
+
+    uint32_t header[4] = {};
+    file.read(rcast<char*>(header), sizeof(header));
+    if (!file || header[0] != sMeshFileMagic || header[1] != sMeshFileVersion || header[2] != powerBits || header[3] != resolutions.size()) {
+        return false;
+    }
+
+    Array<ViewerMesh> result(resolutions.size());
+    for (size_t i = 0; i < resolutions.size(); ++i) {
+        ViewerMesh& mesh = result[i];
+
+        // sizes of the generated mesh, anything else is a broken file
+        const size_t numVertices = (resolutions[i] + 1) * (resolutions[i] / 2 + 1);
+        const size_t numIndices = resolutions[i] * (resolutions[i] / 2) * 6;
+
+        uint32_t lodHeader[3] = {};
+        file.read(rcast<char*>(lodHeader), sizeof(lodHeader));
+        if (!file || lodHeader[0] != resolutions[i] || lodHeader[1] > numVertices || lodHeader[2] != numIndices) {
+            return false;
+        }
+
+        mesh.resolution = resolutions[i];
+        mesh.vertices.resize(lodHeader[1]);
+        mesh.indices.resize(lodHeader[2]);
+        file.read(rcast<char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(vec3));
+        file.read(rcast<char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+        if (!file) {
+            return false;
+        }
+
+        for (const uint32_t index : mesh.indices) {
+            if (index >= mesh.vertices.size()) {
+                return false;
+            }
+        }
+
+        TRACE_BYTES_READ(mesh.vertices.size() * sizeof(vec3) + mesh.indices.size() * sizeof(uint32_t));
+    }
+
+    lods.swap(result);
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+
+
+// The rounded cube of the viewer panel, a unit sphere pushed towards a cube, pole along z.
+// `resolution` segments around, half of it from pole to pole.
+struct ViewerMesh {
+    size_t          resolution;
+    Array<vec3>     vertices;
+    Array<uint32_t> indices;
+};
+
+// `power` determines roundness, 1 is a sphere
+void    GenerateRoundedCube(const size_t resolution, const float power, ViewerMesh& mesh);
+
+// Reorders the triangles for the post-transform vertex cache (Forsyth's linear-speed method),
+// then the vertices in order of first use so the fetches follow along
+void    OptimizeViewerMesh(ViewerMesh& mesh);
+
+// Average cache misses per triangle for a FIFO cache of `cacheSize` entries, 3 is the worst
+float   GetMeshACMR(const Array<uint32_t>& indices, const size_t cacheSize);
+
+// LOD chains are cached on disk, the file only matches the same resolutions and power
+bool    SaveViewerMeshes(const fs::path& path, const float power, const Array<ViewerMesh>& lods);
+bool    LoadViewerMeshes(const fs::path& path, const Array<size_t>& resolutions, const float power, Array<ViewerMesh>& lods);
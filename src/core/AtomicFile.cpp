@@ -0,0 +1,35 @@
+#include "AtomicFile.h"
+
+#include <cstdio>
+#include <random>
+
+
+bool WriteFileAtomic(const fs::path& path, const std::function<bool(std::ofstream& file)>& writer) {
+    // unique per call, two processes writing the same file never share a temp file
+    std::random_device random;
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", random(), random());
+
+    fs::path tempPath = path;
+    tempPath += suffix;
+
+    bool result = false;
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (file && writer(file)) {
+            file.close();
+            result = !file.fail();
+        }
+    }
+
+    std::error_code ec;
+    if (result) {
+        fs::rename(tempPath, path, ec);
+        result = !ec;
+    }
+    if (!result) {
+        fs::remove(tempPath, ec);
+    }
+
+    return result;
+}
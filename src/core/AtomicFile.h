@@ -0,0 +1,11 @@
+#pragma once
+#include "mycommon.h"
+
+#include <fstream>
+#include <functional>
+
+
+// Binary file writes that never leave a torn file behind, for the on-disk caches shared between runs and instances.
+// `writer` fills a uniquely named temp file next to `path`, which is then renamed over `path` in one step,
+// so readers only ever see the old file or the complete new one. False (and no temp file left) if anything failed.
+bool    WriteFileAtomic(const fs::path& path, const std::function<bool(std::ofstream& file)>& writer);
@@ -0,0 +1,265 @@
+#include "BatchConverter.h"
+#include "EnvironmentImage.h"
+#include "Trace.h"
+
+#include "stb_image.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+
+static const size_t sDefaultMemoryBudget = size_t(4) << 30;
+
+static const char* sFormatNames[] = {
+    "auto", "latlong", "cross", "faces"
+};
+
+static double MillisecondsSince(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+BatchConverter::BatchConverter()
+    : mMaxJobs(Maximum(scast<size_t>(std::thread::hardware_concurrency()), size_t(1)))
+    , mMemoryBudget(sDefaultMemoryBudget)
+    , mMathPrecision(MathPrecision::Exact)
+    , mLdrExport(GetDefaultLdrExportSettings())
+    , mWallMs(0.0)
+    , mBytesInFlight(0)
+{
+}
+BatchConverter::~BatchConverter() {
+}
+
+void BatchConverter::SetMaxJobs(const size_t maxJobs) {
+    mMaxJobs = Maximum(maxJobs, size_t(1));
+}
+
+void BatchConverter::SetMemoryBudget(const size_t maxBytes) {
+    mMemoryBudget = maxBytes;
+}
+
+void BatchConverter::SetMathPrecision(const MathPrecision precision) {
+    mMathPrecision = precision;
+}
+
+void BatchConverter::SetLdrExportSettings(const LdrExportSettings& settings) {
+    mLdrExport = settings;
+}
+
+void BatchConverter::SetOutputExtension(const String& extension) {
+    mOutputExtension = extension;
+    if (!mOutputExtension.empty() && mOutputExtension.front() != '.') {
+        mOutputExtension.insert(mOutputExtension.begin(), '.');
+    }
+}
+
+bool BatchConverter::Run(const Array<fs::path>& inputs, const Format from, const Format to, const fs::path& outFolder) {
+    mResults.clear();
+    mResults.resize(inputs.size());
+
+    std::error_code ec;
+    fs::create_directories(outFolder, ec);
+
+    // inputs with the same stem from different folders would overwrite each other's output,
+    // the first one (in input order) wins and the rest are refused.
+    // Compared lower case, the output folder may sit on a case insensitive file system
+    Array<bool> refused(inputs.size(), false);
+    std::unordered_map<String, size_t> outputOwners;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const fs::path output = this->GetOutputPath(inputs[i], to, outFolder);
+        const auto inserted = outputOwners.emplace(ToLowerCase(output.filename().u8string()), i);
+        if (!inserted.second) {
+            fprintf(stderr, "skipping %s: %s already writes %s\n", inputs[i].u8string().c_str(),
+                    inputs[inserted.first->second].u8string().c_str(), output.u8string().c_str());
+            refused[i] = true;
+            mResults[i] = {};
+            mResults[i].input = inputs[i];
+            mResults[i].output = output;
+        }
+    }
+
+    const auto wallStart = std::chrono::steady_clock::now();
+
+    // the queue is just the next unclaimed input, bounded by the number of runners
+    std::atomic<size_t> nextInput(0);
+    std::atomic<bool> allSucceeded(std::find(refused.begin(), refused.end(), true) == refused.end());
+
+    auto runner = [&]() {
+        TRACE_THREAD_NAME("convert runner");
+        for (size_t i = nextInput.fetch_add(1); i < inputs.size(); i = nextInput.fetch_add(1)) {
+            if (!refused[i] && !this->ConvertOne(inputs[i], from, to, outFolder, mResults[i])) {
+                allSucceeded = false;
+            }
+        }
+    };
+
+    const size_t numRunners = Minimum(mMaxJobs, inputs.size());
+    Array<std::thread> runners;
+    for (size_t i = 1; i < numRunners; ++i) {
+        runners.emplace_back(runner);
+    }
+    runner();
+    for (std::thread& t : runners) {
+        t.join();
+    }
+
+    mWallMs = MillisecondsSince(wallStart);
+
+    return allSucceeded;
+}
+
+const Array<BatchConverter::Result>& BatchConverter::GetResults() const {
+    return mResults;
+}
+
+void BatchConverter::PrintReport(FILE* stream) const {
+    size_t numSucceeded = 0;
+    double totalMegapixels = 0.0;
+
+    fprintf(stream, "%-40s %11s %10s %10s %10s  %s\n", "file", "size", "load ms", "conv ms", "total ms", "status");
+    for (const Result& r : mResults) {
+        const String name = r.input.filename().u8string();
+        const String size = std::to_string(r.width) + "x" + std::to_string(r.height);
+        fprintf(stream, "%-40s %11s %10.1f %10.1f %10.1f  %s\n", name.c_str(), size.c_str(), r.loadMs, r.convertSaveMs, r.totalMs, r.succeeded ? "ok" : "FAILED");
+
+        if (r.succeeded) {
+            ++numSucceeded;
+            totalMegapixels += scast<double>(r.width * r.height) / 1e6;
+        }
+    }
+
+    const double wallSeconds = mWallMs / 1000.0;
+    fprintf(stream, "\n%zu/%zu files converted in %.2f s, %.2f files/s, %.1f Mpix/s (%zu jobs, %zu MB budget)\n",
+            numSucceeded, mResults.size(), wallSeconds,
+            wallSeconds > 0.0 ? scast<double>(numSucceeded) / wallSeconds : 0.0,
+            wallSeconds > 0.0 ? totalMegapixels / wallSeconds : 0.0,
+            mMaxJobs, mMemoryBudget >> 20);
+}
+
+bool BatchConverter::ParseFormat(const String& name, Format& format) {
+    for (size_t i = 0; i < std::size(sFormatNames); ++i) {
+        if (name == sFormatNames[i]) {
+            format = scast<Format>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool BatchConverter::ConvertOne(const fs::path& input, const Format from, const Format to, const fs::path& outFolder, Result& result) {
+    TRACE_ZONE("ConvertFile");
+
+    result = {};
+    result.input = input;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    int width = 0, height = 0, numComponents = 0;
+    const String inputUtf8 = input.u8string();
+    if (!stbi_info(inputUtf8.c_str(), &width, &height, &numComponents)) {
+        return false;
+    }
+
+    result.width = scast<size_t>(width);
+    result.height = scast<size_t>(height);
+
+    Format srcFormat = from;
+    if (srcFormat == Format::Auto) {
+        srcFormat = (result.width == result.height * 2) ? Format::LatLong : Format::CubeCross;
+    }
+    // faces come as six files, can't be a single batch input
+    if (srcFormat == Format::CubeFaces || to == Format::Auto) {
+        return false;
+    }
+
+    const String extension = mOutputExtension.empty() ? input.extension().u8string() : mOutputExtension;
+
+    // LDR files keep their own texels, and an LDR save with the default settings never turns them to floats
+    const bool ldrSource = !stbi_is_hdr(inputUtf8.c_str());
+    const bool ldrPassThrough = ldrSource && ToLowerCase(extension) != ".hdr" && IsPassThroughLdrExport(mLdrExport);
+    size_t srcTexelSize = sizeof(vec3);
+    if (ldrSource) {
+        srcTexelSize = stbi_is_16_bit(inputUtf8.c_str()) ? sizeof(Rgb16) : sizeof(Rgb8);
+    }
+
+    // source (loaded, then copied out of stb) + the derived representation, the cross holds the faces
+    const size_t srcTexels = result.width * result.height;
+    const size_t dstTexels = (srcFormat == Format::LatLong) ? (srcTexels / 2) * 3 : (srcTexels / 3) * 2;
+    result.estimatedBytes = srcTexels * srcTexelSize * 2;
+    if (ldrPassThrough) {
+        result.estimatedBytes += dstTexels * sizeof(Rgb8);
+    } else {
+        // the decoded floats of an LDR source come on top
+        result.estimatedBytes += (ldrSource ? srcTexels + dstTexels : dstTexels) * sizeof(vec3);
+    }
+    result.output = this->GetOutputPath(input, to, outFolder);
+
+    {
+        TRACE_ZONE("Wait for memory budget");
+        this->AcquireMemory(result.estimatedBytes);
+    }
+
+    bool succeeded = false;
+    {
+        EnvironmentImage envImg;
+        envImg.SetMathPrecision(mMathPrecision);
+        envImg.SetLdrExportSettings(mLdrExport);
+
+        const auto loadStart = std::chrono::steady_clock::now();
+        const bool loaded = (srcFormat == Format::LatLong) ? envImg.LoadLatLong(input) : envImg.LoadCubeCross(input);
+        result.loadMs = MillisecondsSince(loadStart);
+
+        if (loaded) {
+            const auto convertStart = std::chrono::steady_clock::now();
+            if (to == Format::LatLong) {
+                succeeded = envImg.SaveLatLong(result.output);
+            } else if (to == Format::CubeCross) {
+                succeeded = envImg.SaveCubeCross(result.output);
+            } else {
+                succeeded = envImg.SaveCubeFaces(result.output);
+            }
+            result.convertSaveMs = MillisecondsSince(convertStart);
+        }
+    }
+
+    this->ReleaseMemory(result.estimatedBytes);
+
+    result.succeeded = succeeded;
+    result.totalMs = MillisecondsSince(start);
+
+    TRACE_PIXELS(srcTexels);
+
+    return succeeded;
+}
+
+// faces append their own suffixes to this name
+fs::path BatchConverter::GetOutputPath(const fs::path& input, const Format to, const fs::path& outFolder) const {
+    const String extension = mOutputExtension.empty() ? input.extension().u8string() : mOutputExtension;
+
+    String outName = input.stem().u8string();
+    if (to == Format::LatLong) {
+        outName += "_latlong";
+    } else if (to == Format::CubeCross) {
+        outName += "_cross";
+    }
+    return outFolder / fs::u8path(outName + extension);
+}
+
+void BatchConverter::AcquireMemory(const size_t bytes) {
+    std::unique_lock<std::mutex> lock(mMemoryLock);
+    mMemoryCondition.wait(lock, [this, bytes]() {
+        return mBytesInFlight == 0 || mBytesInFlight + bytes <= mMemoryBudget;
+    });
+    mBytesInFlight += bytes;
+}
+
+void BatchConverter::ReleaseMemory(const size_t bytes) {
+    {
+        std::lock_guard<std::mutex> guard(mMemoryLock);
+        mBytesInFlight -= bytes;
+    }
+    mMemoryCondition.notify_all();
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+#include "LdrQuantize.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+
+
+// Headless, file level parallel conversion between the environment representations.
+// Never touches OpenGL, so it runs fine on a machine without a display.
+//
+// Files are handed out to `maxJobs` runner threads from a bounded queue, a file only starts
+// when its estimated working set fits into the memory budget next to the ones in flight
+// (a file bigger than the whole budget still runs, just on its own).
+// The conversions inside a file keep using the shared ThreadPool.
+class BatchConverter {
+public:
+    enum class Format {
+        Auto,       // guessed from the source aspect (2:1 LatLong, 3:4 cross)
+        LatLong,
+        CubeCross,
+        CubeFaces
+    };
+
+    struct Result {
+        fs::path    input;
+        fs::path    output;
+        bool        succeeded;
+        size_t      width;          // of the source
+        size_t      height;
+        size_t      estimatedBytes;
+        double      loadMs;
+        double      convertSaveMs;
+        double      totalMs;
+    };
+
+    BatchConverter();
+    ~BatchConverter();
+
+    void            SetMaxJobs(const size_t maxJobs);
+    void            SetMemoryBudget(const size_t maxBytes);
+    void            SetMathPrecision(const MathPrecision precision);
+    void            SetLdrExportSettings(const LdrExportSettings& settings);
+    // empty - keep the source extension
+    void            SetOutputExtension(const String& extension);
+
+    // returns true only if every file converted
+    bool            Run(const Array<fs::path>& inputs, const Format from, const Format to, const fs::path& outFolder);
+
+    const Array<Result>& GetResults() const;
+    void            PrintReport(FILE* stream) const;
+
+    static bool     ParseFormat(const String& name, Format& format);
+
+private:
+    bool            ConvertOne(const fs::path& input, const Format from, const Format to, const fs::path& outFolder, Result& result);
+    fs::path        GetOutputPath(const fs::path& input, const Format to, const fs::path& outFolder) const;
+    void            AcquireMemory(const size_t bytes);
+    void            ReleaseMemory(const size_t bytes);
+
+private:
+    size_t                  mMaxJobs;
+    size_t                  mMemoryBudget;
+    MathPrecision           mMathPrecision;
+    LdrExportSettings       mLdrExport;
+    String                  mOutputExtension;
+
+    Array<Result>           mResults;
+    double                  mWallMs;
+
+    std::mutex              mMemoryLock;
+    std::condition_variable mMemoryCondition;
+    size_t                  mBytesInFlight;
+};
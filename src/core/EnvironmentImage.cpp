@@ -0,0 +1,1361 @@
+#include "EnvironmentImage.h"
+#include "LdrPixels.h"
+#include "RadianceHDR.h"
+#include "RemapTable.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#define STBI_NO_PSD
+#define STBI_NO_GIF
+#define STBI_NO_PIC
+#define STBI_NO_PNM
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STBI_MSC_SECURE_CRT
+#define STB_IMAGE_WRITE_STATIC
+#include "stb_image_write.h"
+
+
+// Vertical cross layout
+//
+//      |+Y|
+//   |-X|+Z|+X|
+//      |-Y|
+//      |-Z|
+//
+static const size_t sVerticalCrossOffsetsX[EnvironmentImage::kNumCubeFaces] = {
+    /*+X*/2, /*-X*/0, /*+Y*/1, /*-Y*/1, /*+Z*/1, /*-Z*/1,
+};
+static const size_t sVerticalCrossOffsetsY[EnvironmentImage::kNumCubeFaces] = {
+    /*+X*/1, /*-X*/1, /*+Y*/0, /*-Y*/2, /*+Z*/1, /*-Z*/3,
+};
+
+static const vec3 sFaceUvVectors[EnvironmentImage::kNumCubeFaces][3] = {
+    { // +x face
+        {  0.0f,  0.0f, -1.0f }, // u -> -z
+        {  0.0f, -1.0f,  0.0f }, // v -> -y
+        {  1.0f,  0.0f,  0.0f }, // +x face
+    },
+    { // -x face
+        {  0.0f,  0.0f,  1.0f }, // u -> +z
+        {  0.0f, -1.0f,  0.0f }, // v -> -y
+        { -1.0f,  0.0f,  0.0f }, // -x face
+    },
+    { // +y face
+        {  1.0f,  0.0f,  0.0f }, // u -> +x
+        {  0.0f,  0.0f,  1.0f }, // v -> +z
+        {  0.0f,  1.0f,  0.0f }, // +y face
+    },
+    { // -y face
+        {  1.0f,  0.0f,  0.0f }, // u -> +x
+        {  0.0f,  0.0f, -1.0f }, // v -> -z
+        {  0.0f, -1.0f,  0.0f }, // -y face
+    },
+    { // +z face
+        {  1.0f,  0.0f,  0.0f }, // u -> +x
+        {  0.0f, -1.0f,  0.0f }, // v -> -y
+        {  0.0f,  0.0f,  1.0f }, // +z face
+    },
+    { // -z face
+        { -1.0f,  0.0f,  0.0f }, // u -> -x
+        {  0.0f, -1.0f,  0.0f }, // v -> -y
+        {  0.0f,  0.0f, -1.0f }, // -z face
+    }
+};
+
+// Conversions are split into bands of this many rows, small enough for the
+// work stealing to even out the faces/rows that are more expensive than others.
+static const size_t sConversionTileRows = 16;
+
+// Batched sampling runs through stack buffers of this many lanes, no allocations and no shared state
+static const size_t sSampleBatchChunk = 256;
+
+// Revisions are unique across all the images, so a new image never passes for an older one
+static std::atomic<uint32_t> sNextRevision(1);
+
+static const String sFacesFilenameSuffixes[EnvironmentImage::kNumCubeFaces] = {
+    "_px", "_nx", "_py", "_ny", "_pz", "_nz"
+};
+
+// the face a file is for, by the suffix of its name (any case, "sky_PX" is +X), kInvalidValue if it has none
+static size_t GetCubeFaceFromFilename(const fs::path& path) {
+    const String stem = ToLowerCase(path.stem().u8string());
+    for (size_t i = 0; i < EnvironmentImage::kNumCubeFaces; ++i) {
+        const String& suffix = sFacesFilenameSuffixes[i];
+        if (stem.size() >= suffix.size() && stem.compare(stem.size() - suffix.size(), suffix.size(), suffix) == 0) {
+            return i;
+        }
+    }
+    return kInvalidValue;
+}
+
+// Where the faces sit in a vertical cross, the same whatever the texel type
+
+static size_t GetCubeFaceOffset(const size_t face, const size_t faceWidth, const size_t faceHeight) {
+    return (sVerticalCrossOffsetsY[face] * faceHeight * faceWidth * 3) + (sVerticalCrossOffsetsX[face] * faceWidth);
+}
+
+static ImageOrientation GetCubeFaceOrientation(const size_t face) {
+    // back face is stored rotated 180
+    return (face == scast<size_t>(EnvironmentImage::CubeFace::NegZ)) ? ImageOrientation::Rotated180 : ImageOrientation::Normal;
+}
+
+// texel (x, y) of a face as an index into the cross, what the remap taps address
+static size_t GetCubeCrossTexelIndex(const size_t face, const size_t x, const size_t y, const size_t faceWidth, const size_t faceHeight) {
+    const ImageView8 faceLayout = { nullptr, faceWidth, faceHeight, faceWidth * 3, GetCubeFaceOrientation(face) };
+    return GetCubeFaceOffset(face, faceWidth, faceHeight) + faceLayout.TexelIndex(x, y);
+}
+
+// no views for an empty cross
+template <typename T>
+static void MakeCubeFaceViews(Array<T>& crossData, const size_t crossWidth, const size_t crossHeight, Array<ImageViewT<T>>& faceViews) {
+    const size_t faceWidth = crossWidth / 3;
+    const size_t faceHeight = crossHeight / 4;
+
+    faceViews.resize(crossData.empty() ? 0 : EnvironmentImage::kNumCubeFaces);
+    for (size_t i = 0; i < faceViews.size(); ++i) {
+        faceViews[i] = { crossData.data() + GetCubeFaceOffset(i, faceWidth, faceHeight), faceWidth, faceHeight, crossWidth, GetCubeFaceOrientation(i) };
+    }
+}
+
+template <typename T>
+static void CopyRowToView(const T* src, const ImageViewT<T>& dstView, const size_t y) {
+    T* dst = dstView.RowBegin(y);
+    const ptrdiff_t dstStep = dstView.TexelStep();
+    for (size_t x = 0; x < dstView.width; ++x, dst += dstStep) {
+        *dst = src[x];
+    }
+}
+
+// packed RGB8 rows of an LDR view, for the encoders
+template <typename T>
+static Array<uint8_t> PackLdrImage(const ImageViewT<T>& img) {
+    TRACE_ZONE("Pack LDR");
+    TRACE_BYTES_WRITTEN(img.width * img.height * 3);
+
+    Array<uint8_t> pixels(img.width * img.height * 3);
+    ThreadPool::Get().ParallelFor(0, img.height, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+        for (size_t y = rowBegin; y < rowEnd; ++y) {
+            PackLdrTexels(img.RowBegin(y), img.TexelStep(), img.width, pixels.data() + y * img.width * 3);
+        }
+    });
+    return pixels;
+}
+
+
+EnvironmentImage::EnvironmentImage()
+    : mLatLongTrig{}
+    , mMathPrecision(MathPrecision::Exact)
+    , mLdrExport(GetDefaultLdrExportSettings())
+    , mJobProgress(nullptr)
+    , mRevision(sNextRevision.fetch_add(1))
+    , mSource(RepLatLong)
+    , mValidReps(0)
+{
+}
+EnvironmentImage::~EnvironmentImage() {
+    this->Free();
+}
+
+bool EnvironmentImage::LoadLatLong(const fs::path& path) {
+    TRACE_ZONE("LoadLatLong");
+
+    bool result = false;
+
+    this->Free();
+
+    if (this->LoadImage2D(path, mLatLong)) {
+        mSource = mLatLong.IsLdr() ? RepLatLongLdr : RepLatLong;
+        mValidReps = mSource;
+
+        result = true;
+    }
+
+    return result;
+}
+
+bool EnvironmentImage::LoadCubeCross(const fs::path& path) {
+    TRACE_ZONE("LoadCubeCross");
+
+    bool result = false;
+
+    this->Free();
+
+    if (this->LoadImage2D(path, mCubeCross)) {
+        this->CubeCrossToCubeFaces();
+
+        mSource = mCubeCross.IsLdr() ? RepCubeCrossLdr : RepCubeCross;
+        mValidReps = mSource;
+
+        result = true;
+    }
+
+    return result;
+}
+
+bool EnvironmentImage::CreateLatLong(const size_t width, const size_t height, const vec3* pixels) {
+    this->Free();
+
+    if (!width || !height || !pixels) {
+        return false;
+    }
+
+    mLatLong.width = width;
+    mLatLong.height = height;
+    mLatLong.data.assign(pixels, pixels + width * height);
+
+    mSource = RepLatLong;
+    mValidReps = RepLatLong;
+
+    return true;
+}
+
+bool EnvironmentImage::CreateCubeCross(const size_t width, const size_t height, const vec3* pixels) {
+    this->Free();
+
+    if (!width || !height || !pixels) {
+        return false;
+    }
+
+    mCubeCross.width = width;
+    mCubeCross.height = height;
+    mCubeCross.data.assign(pixels, pixels + width * height);
+    this->CubeCrossToCubeFaces();
+
+    mSource = RepCubeCross;
+    mValidReps = RepCubeCross;
+
+    return true;
+}
+
+bool EnvironmentImage::LoadCubeFaces(const Array<fs::path>& paths) {
+    TRACE_ZONE("LoadCubeFaces");
+
+    this->Free();
+
+    if (paths.size() != kNumCubeFaces) {
+        return false;
+    }
+
+    // every face exactly once
+    fs::path facePaths[kNumCubeFaces];
+    for (const fs::path& path : paths) {
+        const size_t face = GetCubeFaceFromFilename(path);
+        if (face == kInvalidValue || !facePaths[face].empty()) {
+            return false;
+        }
+        facePaths[face] = path;
+    }
+
+    // the headers are enough to turn down mismatching faces before anything is decoded
+    size_t faceWidth = 0, faceHeight = 0;
+    for (size_t i = 0; i < kNumCubeFaces; ++i) {
+        size_t width = 0, height = 0;
+        if (!GetImage2DSize(facePaths[i], width, height) || (i > 0 && (width != faceWidth || height != faceHeight))) {
+            return false;
+        }
+        faceWidth = width;
+        faceHeight = height;
+    }
+
+    // all six at once, the readers spread every face over the pool again
+    Image2D faces[kNumCubeFaces] = {};
+    std::atomic<bool> failed(false);
+
+    this->BeginJobRows(kNumCubeFaces * faceHeight);
+    ThreadPool::Get().ParallelFor(0, kNumCubeFaces, 1, [&](const size_t faceBegin, const size_t faceEnd) {
+        for (size_t i = faceBegin; i < faceEnd && !failed && !this->IsJobCancelled(); ++i) {
+            if (!this->ReadImage2D(facePaths[i], faces[i]) || faces[i].width != faceWidth || faces[i].height != faceHeight) {
+                failed = true;
+            }
+        }
+    });
+
+    if (failed || this->IsJobCancelled()) {
+        return false;
+    }
+
+    // the faces stay LDR if they all have the same depth, a mix is assembled as floats
+    bool all8 = true, all16 = true;
+    for (const Image2D& face : faces) {
+        all8 = all8 && !face.data8.empty();
+        all16 = all16 && !face.data16.empty();
+    }
+
+    {
+        TRACE_ZONE("Assemble cross");
+        TRACE_PIXELS(kNumCubeFaces * faceWidth * faceHeight);
+
+        if (!all8 && !all16) {
+            for (Image2D& face : faces) {
+                if (face.IsLdr()) {
+                    DecodeLdrImage2D(face);
+                }
+            }
+        }
+
+        // the cells around the faces stay black
+        const size_t crossWidth = faceWidth * 3;
+        const size_t crossHeight = faceHeight * 4;
+        mCubeCross.width = crossWidth;
+        mCubeCross.height = crossHeight;
+        if (all8) {
+            mCubeCross.data8.resize(crossWidth * crossHeight);
+        } else if (all16) {
+            mCubeCross.data16.resize(crossWidth * crossHeight);
+        } else {
+            mCubeCross.data.resize(crossWidth * crossHeight);
+        }
+        this->CubeCrossToCubeFaces();
+
+        ThreadPool::Get().ParallelFor(0, kNumCubeFaces * faceHeight, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+            for (size_t row = rowBegin; row < rowEnd; ++row) {
+                const size_t face = row / faceHeight;
+                const size_t y = row % faceHeight;
+
+                if (all8) {
+                    CopyRowToView(faces[face].data8.data() + y * faceWidth, mCubeFaces8[face], y);
+                } else if (all16) {
+                    CopyRowToView(faces[face].data16.data() + y * faceWidth, mCubeFaces16[face], y);
+                } else {
+                    CopyRowToView(faces[face].data.data() + y * faceWidth, mCubeFaces[face], y);
+                }
+            }
+        });
+    }
+
+    mSource = (all8 || all16) ? RepCubeCrossLdr : RepCubeCross;
+    mValidReps = mSource;
+
+    return true;
+}
+
+bool EnvironmentImage::SaveLatLong(const fs::path& path) {
+    TRACE_ZONE("SaveLatLong");
+
+    if (this->IsLdrPassThrough(path)) {
+        this->Require(RepLatLongLdr);
+
+        if (!(mValidReps.load() & RepLatLongLdr)) {
+            return false;
+        } else if (!mLatLong.data16.empty()) {
+            return this->SaveImage2D(path, ImageView16{ mLatLong.data16.data(), mLatLong.width, mLatLong.height, mLatLong.width, ImageOrientation::Normal });
+        } else {
+            return this->SaveImage2D(path, ImageView8{ mLatLong.data8.data(), mLatLong.width, mLatLong.height, mLatLong.width, ImageOrientation::Normal });
+        }
+    }
+
+    this->Require(RepLatLong);
+
+    if (!(mValidReps.load() & RepLatLong)) {
+        return false;
+    } else {
+        return this->SaveImage2D(path, MakeImageView(mLatLong));
+    }
+}
+
+bool EnvironmentImage::SaveCubeCross(const fs::path& path) {
+    TRACE_ZONE("SaveCubeCross");
+
+    if (this->IsLdrPassThrough(path)) {
+        this->Require(RepCubeCrossLdr);
+
+        if (!(mValidReps.load() & RepCubeCrossLdr)) {
+            return false;
+        } else if (!mCubeCross.data16.empty()) {
+            return this->SaveImage2D(path, ImageView16{ mCubeCross.data16.data(), mCubeCross.width, mCubeCross.height, mCubeCross.width, ImageOrientation::Normal });
+        } else {
+            return this->SaveImage2D(path, ImageView8{ mCubeCross.data8.data(), mCubeCross.width, mCubeCross.height, mCubeCross.width, ImageOrientation::Normal });
+        }
+    }
+
+    this->Require(RepCubeCross);
+
+    if (!(mValidReps.load() & RepCubeCross)) {
+        return false;
+    } else {
+        return this->SaveImage2D(path, MakeImageView(mCubeCross));
+    }
+}
+
+bool EnvironmentImage::SaveCubeFaces(const fs::path& path) {
+    TRACE_ZONE("SaveCubeFaces");
+
+    bool result = false;
+
+    const bool ldr = this->IsLdrPassThrough(path);
+    const uint32_t rep = ldr ? RepCubeCrossLdr : RepCubeCross;
+
+    this->Require(rep);
+
+    if (mValidReps.load() & rep) {
+        fs::path rootFolder = path.parent_path();
+        fs::path fileName = path.stem();
+        String extension = path.extension().u8string();
+
+        // the six files are encoded and written at once, the writers spread every face over the pool again
+        std::atomic<bool> failed(false);
+
+        auto writeFaces = [&](const auto& faceViews) {
+            this->BeginJobRows(kNumCubeFaces * faceViews.front().height);
+            ThreadPool::Get().ParallelFor(0, kNumCubeFaces, 1, [&](const size_t faceBegin, const size_t faceEnd) {
+                for (size_t i = faceBegin; i < faceEnd && !failed && !this->IsJobCancelled(); ++i) {
+                    const String& suffix = sFacesFilenameSuffixes[i];
+
+                    fs::path facePath = rootFolder / fileName;
+                    facePath += suffix + extension;
+
+                    if (!this->WriteImage2D(facePath, faceViews[i])) {
+                        failed = true;
+                    }
+                }
+            });
+        };
+
+        if (!ldr) {
+            writeFaces(mCubeFaces);
+        } else if (!mCubeFaces16.empty()) {
+            writeFaces(mCubeFaces16);
+        } else {
+            writeFaces(mCubeFaces8);
+        }
+
+        result = !failed;
+    }
+
+    return result && !this->IsJobCancelled();
+}
+
+void EnvironmentImage::Free() {
+    mLatLong = {};
+    mCubeCross = {};
+    mCubeFaces = {};
+    mCubeFaces8 = {};
+    mCubeFaces16 = {};
+    mValidReps = 0;
+    mRevision = sNextRevision.fetch_add(1);
+}
+
+bool EnvironmentImage::IsEmpty() const {
+    return (mValidReps.load() & RepImages) == 0;
+}
+
+void EnvironmentImage::SetJobProgress(JobProgress* progress) {
+    mJobProgress = progress;
+}
+
+void EnvironmentImage::SetMathPrecision(const MathPrecision precision) {
+    if (mMathPrecision != precision) {
+        mMathPrecision = precision;
+        this->InvalidateDerived();
+        mRevision = sNextRevision.fetch_add(1);
+    }
+}
+
+MathPrecision EnvironmentImage::GetMathPrecision() const {
+    return mMathPrecision;
+}
+
+void EnvironmentImage::SetLdrExportSettings(const LdrExportSettings& settings) {
+    mLdrExport = settings;
+}
+
+const LdrExportSettings& EnvironmentImage::GetLdrExportSettings() const {
+    return mLdrExport;
+}
+
+uint32_t EnvironmentImage::GetRevision() const {
+    return mRevision;
+}
+
+ImageView EnvironmentImage::GetLatLong() {
+    this->Require(RepLatLong);
+    return !(mValidReps.load() & RepLatLong) ? ImageView{} : MakeImageView(mLatLong);
+}
+
+ImageView EnvironmentImage::GetCubeCross() {
+    this->Require(RepCubeCross);
+    return !(mValidReps.load() & RepCubeCross) ? ImageView{} : MakeImageView(mCubeCross);
+}
+
+ImageView EnvironmentImage::GetCubeFace(const CubeFace face) {
+    this->Require(RepCubeCross);
+    return !(mValidReps.load() & RepCubeCross) ? ImageView{} : mCubeFaces[scast<size_t>(face)];
+}
+
+// Derived sizes follow the conversions: a face is a quarter of the LatLong width and half of its height
+
+size_t EnvironmentImage::GetLatLongWidth() const {
+    return (mValidReps.load() & (RepLatLong | RepLatLongLdr)) ? mLatLong.width : this->GetCubeFaceWidth() * 4;
+}
+
+size_t EnvironmentImage::GetLatLongHeight() const {
+    return (mValidReps.load() & (RepLatLong | RepLatLongLdr)) ? mLatLong.height : this->GetCubeFaceHeight() * 2;
+}
+
+size_t EnvironmentImage::GetCubeCrossWidth() const {
+    return this->GetCubeFaceWidth() * 3;
+}
+
+size_t EnvironmentImage::GetCubeCrossHeight() const {
+    return this->GetCubeFaceHeight() * 4;
+}
+
+size_t EnvironmentImage::GetCubeFaceWidth() const {
+    const uint32_t validReps = mValidReps.load();
+    if (validReps & (RepCubeCross | RepCubeCrossLdr)) {
+        return mCubeCross.width / 3;
+    } else {
+        return (validReps & (RepLatLong | RepLatLongLdr)) ? mLatLong.width / 4 : size_t(0);
+    }
+}
+
+size_t EnvironmentImage::GetCubeFaceHeight() const {
+    const uint32_t validReps = mValidReps.load();
+    if (validReps & (RepCubeCross | RepCubeCrossLdr)) {
+        return mCubeCross.height / 4;
+    } else {
+        return (validReps & (RepLatLong | RepLatLongLdr)) ? mLatLong.height / 2 : size_t(0);
+    }
+}
+
+vec3 EnvironmentImage::SampleCube(const vec3& dir) {
+    this->Require(RepCubeCross);
+
+    vec2 faceUv;
+    const CubeFace face = ProjectToCubeFace(dir, faceUv);
+    return this->SampleImage2D(mCubeFaces[scast<size_t>(face)], faceUv.x, faceUv.y);
+}
+
+vec3 EnvironmentImage::SampleLatLong(const vec3& dir) {
+    this->Require(RepLatLong);
+
+    const vec2 uv = DirToLatLong(dir);
+    return this->SampleImage2D(mLatLong, uv.x, uv.y);
+}
+
+void EnvironmentImage::SampleCubeBatch(const vec3* dirs, vec3* out, const size_t count) {
+    float dirX[sSampleBatchChunk], dirY[sSampleBatchChunk], dirZ[sSampleBatchChunk];
+    for (size_t offset = 0; offset < count; offset += sSampleBatchChunk) {
+        const size_t n = Minimum(sSampleBatchChunk, count - offset);
+        for (size_t i = 0; i < n; ++i) {
+            dirX[i] = dirs[offset + i].x;
+            dirY[i] = dirs[offset + i].y;
+            dirZ[i] = dirs[offset + i].z;
+        }
+
+        this->SampleCubeBatch(dirX, dirY, dirZ, out + offset, n);
+    }
+}
+
+void EnvironmentImage::SampleCubeBatch(const float* dirX, const float* dirY, const float* dirZ, vec3* out, const size_t count) {
+    this->Require(RepCubeCross);
+
+    uint8_t faces[sSampleBatchChunk];
+    float u[sSampleBatchChunk], v[sSampleBatchChunk];
+    for (size_t offset = 0; offset < count; offset += sSampleBatchChunk) {
+        const size_t n = Minimum(sSampleBatchChunk, count - offset);
+
+        DirToCubeFaceBatch(dirX + offset, dirY + offset, dirZ + offset, faces, u, v, n);
+
+        for (size_t i = 0; i < n; ++i) {
+            out[offset + i] = this->SampleImage2D(mCubeFaces[faces[i]], u[i], v[i]);
+        }
+    }
+}
+
+void EnvironmentImage::SampleLatLongBatch(const vec3* dirs, vec3* out, const size_t count) {
+    float dirX[sSampleBatchChunk], dirY[sSampleBatchChunk], dirZ[sSampleBatchChunk];
+    for (size_t offset = 0; offset < count; offset += sSampleBatchChunk) {
+        const size_t n = Minimum(sSampleBatchChunk, count - offset);
+        for (size_t i = 0; i < n; ++i) {
+            dirX[i] = dirs[offset + i].x;
+            dirY[i] = dirs[offset + i].y;
+            dirZ[i] = dirs[offset + i].z;
+        }
+
+        this->SampleLatLongBatch(dirX, dirY, dirZ, out + offset, n);
+    }
+}
+
+void EnvironmentImage::SampleLatLongBatch(const float* dirX, const float* dirY, const float* dirZ, vec3* out, const size_t count) {
+    this->Require(RepLatLong);
+
+    float u[sSampleBatchChunk], v[sSampleBatchChunk];
+    for (size_t offset = 0; offset < count; offset += sSampleBatchChunk) {
+        const size_t n = Minimum(sSampleBatchChunk, count - offset);
+
+        DirToLatLongBatch(dirX + offset, dirY + offset, dirZ + offset, u, v, n, mMathPrecision);
+
+        for (size_t i = 0; i < n; ++i) {
+            out[offset + i] = this->SampleImage2D(mLatLong, u[i], v[i]);
+        }
+    }
+}
+
+
+void EnvironmentImage::Require(const uint32_t reps) {
+    if ((mValidReps.load(std::memory_order_acquire) & reps) == reps) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(mDeriveLock);
+
+    uint32_t validReps = mValidReps.load(std::memory_order_relaxed);
+    if ((validReps & RepImages) == 0) {
+        return;
+    }
+
+    // an LDR source is decoded the first time floats are needed, the other projection follows from there
+    if ((reps & RepFloatImages) && !(validReps & RepFloatImages)) {
+        if (mSource == RepLatLongLdr) {
+            DecodeLdrImage2D(mLatLong);
+            validReps |= RepLatLong;
+        } else {
+            DecodeLdrImage2D(mCubeCross);
+            this->CubeCrossToCubeFaces();
+            validReps |= RepCubeCross;
+        }
+    }
+
+    if ((reps & RepCubeCross) && !(validReps & RepCubeCross)) {
+        if (this->LatLongToCubeFaces()) {
+            validReps |= RepCubeCross;
+        }
+    }
+
+    if ((reps & RepLatLong) && !(validReps & RepLatLong)) {
+        if (this->CubeFacesToLatLong()) {
+            validReps |= RepLatLong;
+        }
+    }
+
+    // LDR derivations only ever start from an LDR source
+    if ((reps & RepCubeCrossLdr) && !(validReps & RepCubeCrossLdr) && (validReps & RepLatLongLdr)) {
+        if (this->LatLongToCubeFacesLdr()) {
+            validReps |= RepCubeCrossLdr;
+        }
+    }
+
+    if ((reps & RepLatLongLdr) && !(validReps & RepLatLongLdr) && (validReps & RepCubeCrossLdr)) {
+        if (this->CubeFacesToLatLongLdr()) {
+            validReps |= RepLatLongLdr;
+        }
+    }
+
+    mValidReps.store(validReps, std::memory_order_release);
+}
+
+void EnvironmentImage::InvalidateDerived() {
+    std::lock_guard<std::mutex> guard(mDeriveLock);
+
+    mValidReps &= mSource;
+}
+
+bool EnvironmentImage::IsJobCancelled() const {
+    return mJobProgress && mJobProgress->IsCancelled();
+}
+
+void EnvironmentImage::BeginJobRows(const size_t numRows) {
+    if (mJobProgress) {
+        mJobProgress->BeginItems(numRows);
+    }
+}
+
+void EnvironmentImage::ReportJobRows(const size_t numRows) {
+    if (mJobProgress) {
+        mJobProgress->AddItems(numRows);
+    }
+}
+
+bool EnvironmentImage::LoadImage2D(const fs::path& path, Image2D& img) {
+    size_t width = 0, height = 0;
+    if (!GetImage2DSize(path, width, height)) {
+        return false;
+    }
+
+    this->BeginJobRows(height);
+    return this->ReadImage2D(path, img);
+}
+
+template <typename T>
+bool EnvironmentImage::SaveImage2D(const fs::path& path, const ImageViewT<T>& img) {
+    this->BeginJobRows(img.height);
+    return this->WriteImage2D(path, img);
+}
+
+bool EnvironmentImage::GetImage2DSize(const fs::path& path, size_t& width, size_t& height) {
+    int imgWidth = 0, imgHeight = 0, comp = 0;
+    if (!stbi_info(path.u8string().c_str(), &imgWidth, &imgHeight, &comp) || imgWidth <= 0 || imgHeight <= 0) {
+        return false;
+    }
+
+    width = scast<size_t>(imgWidth);
+    height = scast<size_t>(imgHeight);
+    return true;
+}
+
+bool EnvironmentImage::ReadImage2D(const fs::path& path, Image2D& img) {
+    bool result = false;
+
+    // .hdr has its own parallel reader, stb is left with the LDR formats and whatever that reader turns down
+    if (GetFileFormatExtension(path) == ".hdr") {
+        if (LoadRadianceHDR(path, img.width, img.height, img.data, mJobProgress)) {
+            return true;
+        }
+        if (this->IsJobCancelled()) {
+            return false;
+        }
+    }
+
+    const String pathUtf8 = path.u8string();
+
+    // LDR files keep their own texels
+    if (!stbi_is_hdr(pathUtf8.c_str())) {
+        return this->ReadLdrImage2D(path, img);
+    }
+
+    int width = 0, height = 0, comp = 0;
+    float* imgData = nullptr;
+    {
+        TRACE_ZONE("stbi_loadf");
+        imgData = stbi_loadf(pathUtf8.c_str(), &width, &height, &comp, STBI_rgb);
+        TRACE_PIXELS(width * height);
+        TRACE_BYTES_WRITTEN(width * height * sizeof(vec3));
+    }
+
+    // stb can't be interrupted, at least don't go on with a load that got cancelled meanwhile
+    if (imgData != nullptr && this->IsJobCancelled()) {
+        stbi_image_free(imgData);
+        imgData = nullptr;
+    }
+
+    if (imgData != nullptr) {
+        TRACE_ZONE("ReadImage2D copy");
+        TRACE_BYTES_READ(width * height * sizeof(vec3));
+        TRACE_BYTES_WRITTEN(width * height * sizeof(vec3));
+
+        img.width = scast<size_t>(width);
+        img.height = scast<size_t>(height);
+
+        img.data.resize(width * height);
+        memcpy(img.data.data(), imgData, width * height * sizeof(vec3));
+
+        stbi_image_free(imgData);
+
+        this->ReportJobRows(img.height);
+
+        result = true;
+    }
+
+    return result;
+}
+
+bool EnvironmentImage::ReadLdrImage2D(const fs::path& path, Image2D& img) {
+    static_assert(sizeof(Rgb8) == 3 && sizeof(Rgb16) == 6, "LDR texels are copied straight from stb's packed RGB");
+
+    bool result = false;
+
+    const String pathUtf8 = path.u8string();
+    const bool is16Bit = (stbi_is_16_bit(pathUtf8.c_str()) != 0);
+    const size_t texelSize = is16Bit ? sizeof(Rgb16) : sizeof(Rgb8);
+
+    int width = 0, height = 0, comp = 0;
+    void* imgData = nullptr;
+    {
+        TRACE_ZONE("stbi_load");
+        if (is16Bit) {
+            imgData = stbi_load_16(pathUtf8.c_str(), &width, &height, &comp, STBI_rgb);
+        } else {
+            imgData = stbi_load(pathUtf8.c_str(), &width, &height, &comp, STBI_rgb);
+        }
+        TRACE_PIXELS(width * height);
+        TRACE_BYTES_WRITTEN(width * height * texelSize);
+    }
+
+    // stb can't be interrupted, at least don't go on with a load that got cancelled meanwhile
+    if (imgData != nullptr && this->IsJobCancelled()) {
+        stbi_image_free(imgData);
+        imgData = nullptr;
+    }
+
+    if (imgData != nullptr) {
+        TRACE_ZONE("ReadLdrImage2D copy");
+        TRACE_BYTES_READ(width * height * texelSize);
+        TRACE_BYTES_WRITTEN(width * height * texelSize);
+
+        img.width = scast<size_t>(width);
+        img.height = scast<size_t>(height);
+
+        if (is16Bit) {
+            img.data16.resize(width * height);
+            memcpy(img.data16.data(), imgData, width * height * texelSize);
+        } else {
+            img.data8.resize(width * height);
+            memcpy(img.data8.data(), imgData, width * height * texelSize);
+        }
+
+        stbi_image_free(imgData);
+
+        this->ReportJobRows(img.height);
+
+        result = true;
+    }
+
+    return result;
+}
+
+bool EnvironmentImage::WriteImage2D(const fs::path& path, const ImageView& img) {
+    const String extension = GetFileFormatExtension(path);
+
+    TRACE_ZONE("WriteImage2D");
+    TRACE_PIXELS(img.width * img.height);
+    TRACE_BYTES_READ(img.width * img.height * sizeof(vec3));
+
+    // straight from the view, strided and rotated ones included
+    if (extension == ".hdr") {
+        return SaveRadianceHDR(path, img, mJobProgress);
+    }
+
+    // quantized straight into what the encoders take
+    Array<uint8_t> ldrPixels(img.width * img.height * 3);
+    {
+        TRACE_ZONE("Quantize LDR");
+        TRACE_BYTES_WRITTEN(ldrPixels.size());
+
+        const size_t rowBytes = img.width * 3;
+        ThreadPool::Get().ParallelFor(0, img.height, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+            for (size_t y = rowBegin; y < rowEnd; ++y) {
+                QuantizeLdrRow(img.RowBegin(y), img.TexelStep(), img.width, y, mLdrExport, ldrPixels.data() + y * rowBytes);
+            }
+        });
+    }
+
+    return this->WriteLdrPixels(path, img.width, img.height, ldrPixels.data());
+}
+
+bool EnvironmentImage::WriteImage2D(const fs::path& path, const ImageView8& img) {
+    TRACE_ZONE("WriteImage2D LDR");
+    TRACE_PIXELS(img.width * img.height);
+
+    // a whole 8 bit image is what the encoders take already
+    if (img.IsContiguous()) {
+        return this->WriteLdrPixels(path, img.width, img.height, rcast<const uint8_t*>(img.data));
+    } else {
+        return this->WriteLdrPixels(path, img.width, img.height, PackLdrImage(img).data());
+    }
+}
+
+bool EnvironmentImage::WriteImage2D(const fs::path& path, const ImageView16& img) {
+    TRACE_ZONE("WriteImage2D LDR");
+    TRACE_PIXELS(img.width * img.height);
+
+    // the stb encoders only write 8 bit
+    return this->WriteLdrPixels(path, img.width, img.height, PackLdrImage(img).data());
+}
+
+bool EnvironmentImage::WriteLdrPixels(const fs::path& path, const size_t width, const size_t height, const uint8_t* pixels) {
+    const String pathUtf8 = path.u8string();
+    const String extension = GetFileFormatExtension(path);
+
+    TRACE_ZONE("stbi_write_ldr");
+    TRACE_BYTES_READ(width * height * 3);
+
+    int stbiRet = 0;
+    if (extension == ".bmp") {
+        stbiRet = stbi_write_bmp(pathUtf8.c_str(), scast<int>(width), scast<int>(height), STBI_rgb, pixels);
+    } else if (extension == ".jpg") {
+        stbiRet = stbi_write_jpg(pathUtf8.c_str(), scast<int>(width), scast<int>(height), STBI_rgb, pixels, 95);
+    } else if (extension == ".tga") {
+        stbiRet = stbi_write_tga(pathUtf8.c_str(), scast<int>(width), scast<int>(height), STBI_rgb, pixels);
+    } else if (extension == ".png") {
+        stbiRet = stbi_write_png(pathUtf8.c_str(), scast<int>(width), scast<int>(height), STBI_rgb, pixels, 0);
+    }
+
+    const bool result = (stbiRet != 0);
+    if (result) {
+        this->ReportJobRows(height);
+    }
+
+    return result;
+}
+
+EnvironmentImage::CubeFace EnvironmentImage::ProjectToCubeFace(const vec3& dir, vec2& faceUv) {
+    const vec3 absVec(std::fabsf(dir.x), std::fabsf(dir.y), std::fabsf(dir.z));
+
+    const float maxAxis = Maximum(Maximum(absVec.x, absVec.y), absVec.z);
+
+    // Get face id (max component == face vector).
+    CubeFace face;
+    if (maxAxis == absVec.x) {
+        face = (dir.x >= 0.0f) ? CubeFace::PosX : CubeFace::NegX;
+    } else if (maxAxis == absVec.y) {
+        face = (dir.y >= 0.0f) ? CubeFace::PosY : CubeFace::NegY;
+    } else /* if (maxAxis == absVec.z) */ {
+        face = (dir.z >= 0.0f) ? CubeFace::PosZ : CubeFace::NegZ;
+    }
+
+    vec3 faceVec = dir / maxAxis;
+
+    // Project other two components to face uv basis.
+    faceUv.x = (Dot(sFaceUvVectors[scast<size_t>(face)][0], faceVec) + 1.0f) * 0.5f;
+    faceUv.y = (Dot(sFaceUvVectors[scast<size_t>(face)][1], faceVec) + 1.0f) * 0.5f;
+
+    assert(faceUv.x >= 0.0f && faceUv.x <= 1.0f);
+    assert(faceUv.y >= 0.0f && faceUv.y <= 1.0f);
+
+    return face;
+}
+
+const EnvironmentImage::LatLongTrigTables& EnvironmentImage::GetLatLongTrigTables(const size_t width, const size_t height) {
+    if (mLatLongTrig.width != width || mLatLongTrig.height != height) {
+        // same float math as LatLongToDir, the tables reproduce it bit for bit
+        const float invWidth = 1.0f / scast<float>(width - 1);
+        const float invHeight = 1.0f / scast<float>(height - 1);
+
+        mLatLongTrig.width = width;
+        mLatLongTrig.height = height;
+
+        mLatLongTrig.sinCosPhi.resize(width);
+        for (size_t x = 0; x < width; ++x) {
+            const float phi = (scast<float>(x) * invWidth) * MM_TwoPi;
+            mLatLongTrig.sinCosPhi[x] = vec2(std::sinf(phi), std::cosf(phi));
+        }
+
+        mLatLongTrig.sinCosTheta.resize(height);
+        for (size_t y = 0; y < height; ++y) {
+            const float theta = (scast<float>(y) * invHeight) * MM_Pi;
+            mLatLongTrig.sinCosTheta[y] = vec2(std::sinf(theta), std::cosf(theta));
+        }
+    }
+
+    return mLatLongTrig;
+}
+
+ImageView EnvironmentImage::MakeImageView(Image2D& img) {
+    return { img.data.data(), img.width, img.height, img.width, ImageOrientation::Normal };
+}
+
+void EnvironmentImage::DecodeLdrImage2D(Image2D& img) {
+    TRACE_ZONE("DecodeLdrImage2D");
+    TRACE_PIXELS(img.width * img.height);
+    TRACE_BYTES_WRITTEN(img.width * img.height * sizeof(vec3));
+
+    const size_t width = img.width;
+    img.data.resize(width * img.height);
+
+    ThreadPool::Get().ParallelFor(0, img.height, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+        for (size_t y = rowBegin; y < rowEnd; ++y) {
+            if (!img.data16.empty()) {
+                DecodeLdrTexels(img.data16.data() + y * width, 1, width, img.data.data() + y * width);
+            } else {
+                DecodeLdrTexels(img.data8.data() + y * width, 1, width, img.data.data() + y * width);
+            }
+        }
+    });
+}
+
+bool EnvironmentImage::IsLdrPassThrough(const fs::path& path) const {
+    return (mSource & RepLdrImages) && GetFileFormatExtension(path) != ".hdr" && IsPassThroughLdrExport(mLdrExport);
+}
+
+vec3 EnvironmentImage::SampleImage2D(const ImageView& img, const float u, const float v) const {
+    // Bilinear, clamped
+    RemapTap tap;
+    MakeBilinearTap(img, u, v, tap);
+    return ApplyBilinearTap(img.data, tap);
+}
+
+vec3 EnvironmentImage::SampleImage2D(const Image2D& img, const float u, const float v) const {
+#if 0
+    // Nearest
+    const size_t ix = scast<size_t>(img.width * u) % img.width;
+    const size_t iy = scast<size_t>(img.height * v) % img.height;
+    return img.data[ix + iy * img.width];
+#else
+    // Bilinear, clamped
+    RemapTap tap;
+    MakeBilinearTap(img.width, img.height, u, v, tap);
+    return ApplyBilinearTap(img.data.data(), tap);
+#endif
+}
+
+void EnvironmentImage::LatLongToCubeFacesRowUv(const size_t face, const size_t y, const size_t faceWidth, const size_t faceHeight, float* rowScratch) const {
+    const float invHalfFaceWidth = 2.0f / scast<float>(faceWidth - 1);
+    const float invHalfFaceHeight = 2.0f / scast<float>(faceHeight - 1);
+
+    // a row of directions in SoA form, the LatLong uv then overwrites x and y
+    float* dirX = rowScratch;
+    float* dirY = dirX + faceWidth;
+    float* dirZ = dirY + faceWidth;
+
+    const float fv = (scast<float>(y) * invHalfFaceHeight) - 1.0f;
+
+    const vec3& axisU = sFaceUvVectors[face][0];
+    const vec3& axisV = sFaceUvVectors[face][1];
+    const vec3& axisN = sFaceUvVectors[face][2];
+    for (size_t x = 0; x < faceWidth; ++x) {
+        const float fu = (scast<float>(x) * invHalfFaceWidth) - 1.0f;
+
+        dirX[x] = axisU.x * fu + axisV.x * fv + axisN.x;
+        dirY[x] = axisU.y * fu + axisV.y * fv + axisN.y;
+        dirZ[x] = axisU.z * fu + axisV.z * fv + axisN.z;
+    }
+
+    NormalizeBatch(dirX, dirY, dirZ, faceWidth);
+    DirToLatLongBatch(dirX, dirY, dirZ, dirX, dirY, faceWidth, mMathPrecision);
+}
+
+void EnvironmentImage::CubeFacesToLatLongRowUv(const LatLongTrigTables& trig, const size_t y, uint8_t* rowFaces, float* rowScratch) const {
+    const size_t width = trig.width;
+    const vec2& sinCosTheta = trig.sinCosTheta[y];
+
+    // a row of directions in SoA form, the face uv then overwrites x and y
+    float* dirX = rowScratch;
+    float* dirY = dirX + width;
+    float* dirZ = dirY + width;
+    for (size_t x = 0; x < width; ++x) {
+        const vec3 dir = SinCosToDir(trig.sinCosPhi[x], sinCosTheta);
+        dirX[x] = dir.x;
+        dirY[x] = dir.y;
+        dirZ[x] = dir.z;
+    }
+
+    DirToCubeFaceBatch(dirX, dirY, dirZ, rowFaces, dirX, dirY, width);
+}
+
+RemapTableCache::TablePtr EnvironmentImage::FindLatLongToCubeFacesTable(const size_t latLongWidth, const size_t latLongHeight) {
+    const size_t faceWidth = latLongWidth / 4;
+    const size_t faceHeight = latLongHeight / 2;
+    const size_t numRows = kNumCubeFaces * faceHeight;
+
+    JobProgressScope buildScope(mJobProgress, 0.0f, 0.5f);
+
+    const RemapKey key = { EnvProjection::LatLong, EnvProjection::CubeFaces, latLongWidth, latLongHeight, faceWidth, faceHeight, mMathPrecision };
+    return RemapTableCache::Get().FindOrBuild(key, kNumCubeFaces, [&](RemapTable& newTable) {
+        this->BeginJobRows(numRows);
+
+        ThreadPool::Get().ParallelFor(0, numRows, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+            if (this->IsJobCancelled()) {
+                return;
+            }
+
+            Array<float> rowScratch(faceWidth * 3);
+            for (size_t row = rowBegin; row < rowEnd; ++row) {
+                this->LatLongToCubeFacesRowUv(row / faceHeight, row % faceHeight, faceWidth, faceHeight, rowScratch.data());
+
+                const float* rowU = rowScratch.data();
+                const float* rowV = rowU + faceWidth;
+                RemapTap* taps = newTable.GetRowTaps(row);
+                for (size_t x = 0; x < faceWidth; ++x) {
+                    MakeBilinearTap(latLongWidth, latLongHeight, rowU[x], rowV[x], taps[x]);
+                }
+            }
+
+            this->ReportJobRows(rowEnd - rowBegin);
+        });
+
+        return !this->IsJobCancelled();
+    });
+}
+
+RemapTableCache::TablePtr EnvironmentImage::FindCubeFacesToLatLongTable(const size_t faceWidth, const size_t faceHeight) {
+    const size_t latLongWidth = faceWidth * 4;
+    const size_t latLongHeight = faceHeight * 2;
+
+    // no trig in the loop, the directions come from per-column and per-row (sin, cos) pairs
+    const LatLongTrigTables& trig = this->GetLatLongTrigTables(latLongWidth, latLongHeight);
+
+    JobProgressScope buildScope(mJobProgress, 0.0f, 0.5f);
+
+    const RemapKey key = { EnvProjection::CubeFaces, EnvProjection::LatLong, faceWidth, faceHeight, latLongWidth, latLongHeight, MathPrecision::Exact };
+    return RemapTableCache::Get().FindOrBuild(key, 1, [&](RemapTable& newTable) {
+        this->BeginJobRows(latLongHeight);
+
+        ThreadPool::Get().ParallelFor(0, latLongHeight, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+            if (this->IsJobCancelled()) {
+                return;
+            }
+
+            Array<uint8_t> rowFaces(latLongWidth);
+            Array<float> rowScratch(latLongWidth * 3);
+            for (size_t y = rowBegin; y < rowEnd; ++y) {
+                this->CubeFacesToLatLongRowUv(trig, y, rowFaces.data(), rowScratch.data());
+
+                const float* rowU = rowScratch.data();
+                const float* rowV = rowU + latLongWidth;
+                RemapTap* taps = newTable.GetRowTaps(y);
+                for (size_t x = 0; x < latLongWidth; ++x) {
+                    // the taps address the whole cross, face placement and -Z rotation included
+                    const size_t face = rowFaces[x];
+                    MakeBilinearTap(faceWidth, faceHeight, rowU[x], rowV[x], taps[x], [&](const size_t fx, const size_t fy) {
+                        return GetCubeCrossTexelIndex(face, fx, fy, faceWidth, faceHeight);
+                    });
+                }
+            }
+
+            this->ReportJobRows(rowEnd - rowBegin);
+        });
+
+        return !this->IsJobCancelled();
+    });
+}
+
+bool EnvironmentImage::LatLongToCubeFaces() {
+    TRACE_ZONE("LatLongToCubeFaces");
+
+    const size_t latLongWidth = mLatLong.width;
+    const size_t latLongHeight = mLatLong.height;
+
+    const size_t faceWidth = latLongWidth / 4;
+    const size_t faceHeight = latLongHeight / 2;
+    TRACE_PIXELS(faceWidth * faceHeight * kNumCubeFaces);
+
+    // the faces are rendered straight into their places in the cross
+    mCubeCross.width = faceWidth * 3;
+    mCubeCross.height = faceHeight * 4;
+    mCubeCross.data.resize(mCubeCross.width * mCubeCross.height);
+    this->CubeCrossToCubeFaces();
+
+    // all the faces' rows form a single range, so a thread that is done with its face helps with the others
+    const size_t numRows = kNumCubeFaces * faceHeight;
+
+    if (RemapTableCache::Get().CanCache(numRows * faceWidth * sizeof(RemapTap))) {
+        const RemapTableCache::TablePtr table = this->FindLatLongToCubeFacesTable(latLongWidth, latLongHeight);
+        if (!table) {
+            return false;
+        }
+
+        JobProgressScope applyScope(mJobProgress, 0.5f, 1.0f);
+        table->Apply(mLatLong.data.data(), mCubeFaces.data(), mJobProgress);
+    } else {
+        // too big to keep around, sample directly
+        this->BeginJobRows(numRows);
+
+        ThreadPool::Get().ParallelFor(0, numRows, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+            if (this->IsJobCancelled()) {
+                return;
+            }
+
+            Array<float> rowScratch(faceWidth * 3);
+            for (size_t row = rowBegin; row < rowEnd; ++row) {
+                this->LatLongToCubeFacesRowUv(row / faceHeight, row % faceHeight, faceWidth, faceHeight, rowScratch.data());
+
+                const float* rowU = rowScratch.data();
+                const float* rowV = rowU + faceWidth;
+                const ImageView& faceView = mCubeFaces[row / faceHeight];
+                vec3* cubeFacePtr = faceView.RowBegin(row % faceHeight);
+                const ptrdiff_t cubeFaceStep = faceView.TexelStep();
+                for (size_t x = 0; x < faceWidth; ++x, cubeFacePtr += cubeFaceStep) {
+                    *cubeFacePtr = this->SampleImage2D(mLatLong, rowU[x], rowV[x]);
+                }
+            }
+
+            this->ReportJobRows(rowEnd - rowBegin);
+        });
+    }
+
+    return !this->IsJobCancelled();
+}
+
+void EnvironmentImage::CubeCrossToCubeFaces() {
+    MakeCubeFaceViews(mCubeCross.data, mCubeCross.width, mCubeCross.height, mCubeFaces);
+    MakeCubeFaceViews(mCubeCross.data8, mCubeCross.width, mCubeCross.height, mCubeFaces8);
+    MakeCubeFaceViews(mCubeCross.data16, mCubeCross.width, mCubeCross.height, mCubeFaces16);
+}
+
+bool EnvironmentImage::CubeFacesToLatLong() {
+    TRACE_ZONE("CubeFacesToLatLong");
+
+    if (mCubeFaces.empty()) {
+        return false;
+    }
+
+    const size_t faceWidth = mCubeFaces.front().width;
+    const size_t faceHeight = mCubeFaces.front().height;
+
+    const size_t latLongWidth = faceWidth * 4;
+    const size_t latLongHeight = faceHeight * 2;
+    TRACE_PIXELS(latLongWidth * latLongHeight);
+
+    mLatLong.width = latLongWidth;
+    mLatLong.height = latLongHeight;
+    mLatLong.data.resize(latLongWidth * latLongHeight);
+
+    if (RemapTableCache::Get().CanCache(latLongWidth * latLongHeight * sizeof(RemapTap))) {
+        const RemapTableCache::TablePtr table = this->FindCubeFacesToLatLongTable(faceWidth, faceHeight);
+        if (!table) {
+            return false;
+        }
+
+        JobProgressScope applyScope(mJobProgress, 0.5f, 1.0f);
+        const ImageView latLongView = MakeImageView(mLatLong);
+        table->Apply(mCubeCross.data.data(), &latLongView, mJobProgress);
+    } else {
+        // too big to keep around, sample directly
+        const LatLongTrigTables& trig = this->GetLatLongTrigTables(latLongWidth, latLongHeight);
+
+        this->BeginJobRows(latLongHeight);
+
+        ThreadPool::Get().ParallelFor(0, latLongHeight, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+            if (this->IsJobCancelled()) {
+                return;
+            }
+
+            Array<uint8_t> rowFaces(latLongWidth);
+            Array<float> rowScratch(latLongWidth * 3);
+            for (size_t y = rowBegin; y < rowEnd; ++y) {
+                this->CubeFacesToLatLongRowUv(trig, y, rowFaces.data(), rowScratch.data());
+
+                const float* rowU = rowScratch.data();
+                const float* rowV = rowU + latLongWidth;
+                vec3* latLongData = mLatLong.data.data() + y * latLongWidth;
+                for (size_t x = 0; x < latLongWidth; ++x, ++latLongData) {
+                    *latLongData = this->SampleImage2D(mCubeFaces[rowFaces[x]], rowU[x], rowV[x]);
+                }
+            }
+
+            this->ReportJobRows(rowEnd - rowBegin);
+        });
+    }
+
+    return !this->IsJobCancelled();
+}
+
+// The LDR conversions take the same taps as the float ones, the texels are filtered in 16 bit linear light
+// and land in 8 bit sRGB (LdrPixels.h). The source is 8 or 16 bit, the result always 8.
+
+bool EnvironmentImage::LatLongToCubeFacesLdr() {
+    TRACE_ZONE("LatLongToCubeFacesLdr");
+
+    const size_t latLongWidth = mLatLong.width;
+    const size_t latLongHeight = mLatLong.height;
+
+    const size_t faceWidth = latLongWidth / 4;
+    const size_t faceHeight = latLongHeight / 2;
+    TRACE_PIXELS(faceWidth * faceHeight * kNumCubeFaces);
+
+    mCubeCross.width = faceWidth * 3;
+    mCubeCross.height = faceHeight * 4;
+    mCubeCross.data8.resize(mCubeCross.width * mCubeCross.height);
+    this->CubeCrossToCubeFaces();
+
+    const size_t numRows = kNumCubeFaces * faceHeight;
+
+    if (RemapTableCache::Get().CanCache(numRows * faceWidth * sizeof(RemapTap))) {
+        const RemapTableCache::TablePtr table = this->FindLatLongToCubeFacesTable(latLongWidth, latLongHeight);
+        if (!table) {
+            return false;
+        }
+
+        JobProgressScope applyScope(mJobProgress, 0.5f, 1.0f);
+        if (!mLatLong.data16.empty()) {
+            table->Apply(mLatLong.data16.data(), mCubeFaces8.data(), mJobProgress);
+        } else {
+            table->Apply(mLatLong.data8.data(), mCubeFaces8.data(), mJobProgress);
+        }
+    } else {
+        // too big to keep around, the taps of a row at a time
+        this->BeginJobRows(numRows);
+
+        ThreadPool::Get().ParallelFor(0, numRows, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+            if (this->IsJobCancelled()) {
+                return;
+            }
+
+            Array<float> rowScratch(faceWidth * 3);
+            Array<RemapTap> rowTaps(faceWidth);
+            for (size_t row = rowBegin; row < rowEnd; ++row) {
+                this->LatLongToCubeFacesRowUv(row / faceHeight, row % faceHeight, faceWidth, faceHeight, rowScratch.data());
+
+                const float* rowU = rowScratch.data();
+                const float* rowV = rowU + faceWidth;
+                for (size_t x = 0; x < faceWidth; ++x) {
+                    MakeBilinearTap(latLongWidth, latLongHeight, rowU[x], rowV[x], rowTaps[x]);
+                }
+
+                const ImageView8& faceView = mCubeFaces8[row / faceHeight];
+                Rgb8* dst = faceView.RowBegin(row % faceHeight);
+                if (!mLatLong.data16.empty()) {
+                    RemapLdrTexels(mLatLong.data16.data(), rowTaps.data(), faceWidth, dst, faceView.TexelStep());
+                } else {
+                    RemapLdrTexels(mLatLong.data8.data(), rowTaps.data(), faceWidth, dst, faceView.TexelStep());
+                }
+            }
+
+            this->ReportJobRows(rowEnd - rowBegin);
+        });
+    }
+
+    return !this->IsJobCancelled();
+}
+
+bool EnvironmentImage::CubeFacesToLatLongLdr() {
+    TRACE_ZONE("CubeFacesToLatLongLdr");
+
+    const size_t faceWidth = mCubeCross.width / 3;
+    const size_t faceHeight = mCubeCross.height / 4;
+
+    const size_t latLongWidth = faceWidth * 4;
+    const size_t latLongHeight = faceHeight * 2;
+    TRACE_PIXELS(latLongWidth * latLongHeight);
+
+    mLatLong.width = latLongWidth;
+    mLatLong.height = latLongHeight;
+    mLatLong.data8.resize(latLongWidth * latLongHeight);
+
+    if (RemapTableCache::Get().CanCache(latLongWidth * latLongHeight * sizeof(RemapTap))) {
+        const RemapTableCache::TablePtr table = this->FindCubeFacesToLatLongTable(faceWidth, faceHeight);
+        if (!table) {
+            return false;
+        }
+
+        JobProgressScope applyScope(mJobProgress, 0.5f, 1.0f);
+        const ImageView8 latLongView = { mLatLong.data8.data(), latLongWidth, latLongHeight, latLongWidth, ImageOrientation::Normal };
+        if (!mCubeCross.data16.empty()) {
+            table->Apply(mCubeCross.data16.data(), &latLongView, mJobProgress);
+        } else {
+            table->Apply(mCubeCross.data8.data(), &latLongView, mJobProgress);
+        }
+    } else {
+        // too big to keep around, the taps of a row at a time
+        const LatLongTrigTables& trig = this->GetLatLongTrigTables(latLongWidth, latLongHeight);
+
+        this->BeginJobRows(latLongHeight);
+
+        ThreadPool::Get().ParallelFor(0, latLongHeight, sConversionTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+            if (this->IsJobCancelled()) {
+                return;
+            }
+
+            Array<uint8_t> rowFaces(latLongWidth);
+            Array<float> rowScratch(latLongWidth * 3);
+            Array<RemapTap> rowTaps(latLongWidth);
+            for (size_t y = rowBegin; y < rowEnd; ++y) {
+                this->CubeFacesToLatLongRowUv(trig, y, rowFaces.data(), rowScratch.data());
+
+                const float* rowU = rowScratch.data();
+                const float* rowV = rowU + latLongWidth;
+                for (size_t x = 0; x < latLongWidth; ++x) {
+                    const size_t face = rowFaces[x];
+                    MakeBilinearTap(faceWidth, faceHeight, rowU[x], rowV[x], rowTaps[x], [&](const size_t fx, const size_t fy) {
+                        return GetCubeCrossTexelIndex(face, fx, fy, faceWidth, faceHeight);
+                    });
+                }
+
+                Rgb8* dst = mLatLong.data8.data() + y * latLongWidth;
+                if (!mCubeCross.data16.empty()) {
+                    RemapLdrTexels(mCubeCross.data16.data(), rowTaps.data(), latLongWidth, dst, 1);
+                } else {
+                    RemapLdrTexels(mCubeCross.data8.data(), rowTaps.data(), latLongWidth, dst, 1);
+                }
+            }
+
+            this->ReportJobRows(rowEnd - rowBegin);
+        });
+    }
+
+    return !this->IsJobCancelled();
+}
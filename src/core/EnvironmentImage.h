@@ -0,0 +1,192 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+#include "ImageView.h"
+#include "JobProgress.h"
+#include "LdrQuantize.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+class RemapTable;
+
+
+class EnvironmentImage {
+public:
+    enum class CubeFace : size_t {
+        PosX = 0,
+        NegX = 1,
+        PosY = 2,
+        NegY = 3,
+        PosZ = 4,
+        NegZ = 5
+    };
+
+    static const size_t kNumCubeFaces = 6;
+
+private:
+    // LDR files keep their sRGB texels (8 or 16 bit, one of the two arrays), floats are decoded from them on demand
+    struct Image2D {
+        size_t          width;
+        size_t          height;
+        Array<vec3>     data;
+        Array<Rgb8>     data8;
+        Array<Rgb16>    data16;
+
+        bool IsLdr() const {
+            return !data8.empty() || !data16.empty();
+        }
+    };
+
+    // Only the loaded representation is valid up front, the other one is derived on first read
+    // (a getter, a Save* call or sampling) and dropped when its source changes
+    enum Representation : uint32_t {
+        RepLatLong          = 1u << 0,
+        RepCubeCross        = 1u << 1,  // the face views come with the cross
+        // the texels of an LDR source, and the 8 bit images derived from them for LDR saves
+        RepLatLongLdr       = 1u << 2,
+        RepCubeCrossLdr     = 1u << 3,
+
+        RepFloatImages      = RepLatLong | RepCubeCross,
+        RepLdrImages        = RepLatLongLdr | RepCubeCrossLdr,
+        RepImages           = RepFloatImages | RepLdrImages
+    };
+
+    // (sin, cos) of phi per LatLong column and of theta per LatLong row
+    struct LatLongTrigTables {
+        size_t      width;
+        size_t      height;
+        Array<vec2> sinCosPhi;
+        Array<vec2> sinCosTheta;
+    };
+
+public:
+    EnvironmentImage();
+    ~EnvironmentImage();
+
+    bool    LoadLatLong(const fs::path& path);
+    bool    LoadCubeCross(const fs::path& path);
+    bool    LoadCubeFaces(const Array<fs::path>& paths);
+
+    // From pixels in memory (copied), same as loading a file of that projection
+    bool    CreateLatLong(const size_t width, const size_t height, const vec3* pixels);
+    bool    CreateCubeCross(const size_t width, const size_t height, const vec3* pixels);
+
+    // Deriving the missing representation happens here if needed
+    bool    SaveLatLong(const fs::path& path);
+    bool    SaveCubeCross(const fs::path& path);
+    bool    SaveCubeFaces(const fs::path& path);
+
+    void    Free();
+    bool    IsEmpty() const;
+
+    // Progress / cancellation of the Load*, Save* and derivation calls that follow, nullptr to detach.
+    // A cancelled derivation leaves the representation invalid, so it is derived again on the next read.
+    void    SetJobProgress(JobProgress* progress);
+
+    // Exact (default) keeps conversions bit-identical to the libm results, Fast uses the batched polynomials
+    void    SetMathPrecision(const MathPrecision precision);
+    MathPrecision GetMathPrecision() const;
+
+    // How the LDR formats (.png, .jpg, .tga, .bmp) are quantized on save. With the defaults an LDR
+    // source is saved to them from its own texels, converted with fixed point filters if needed, never as floats.
+    void    SetLdrExportSettings(const LdrExportSettings& settings);
+    const LdrExportSettings& GetLdrExportSettings() const;
+
+    // Bumped whenever the pixels may have changed (load, free, precision change), lets the users cache derived data
+    uint32_t GetRevision() const;
+
+    // Pixel access, derives the representation if needed. Empty views (nullptr data) if nothing is loaded.
+    ImageView GetLatLong();
+    ImageView GetCubeCross();
+    ImageView GetCubeFace(const CubeFace face);
+
+    // Sizes are known without deriving anything
+
+    size_t  GetLatLongWidth() const;
+    size_t  GetLatLongHeight() const;
+    size_t  GetCubeCrossWidth() const;
+    size_t  GetCubeCrossHeight() const;
+    size_t  GetCubeFaceWidth() const;
+    size_t  GetCubeFaceHeight() const;
+
+    vec3    SampleCube(const vec3& dir);
+    vec3    SampleLatLong(const vec3& dir);
+
+    // Batched lookups, safe to call from many threads at once. The float* overloads take SoA directions.
+    void    SampleCubeBatch(const vec3* dirs, vec3* out, const size_t count);
+    void    SampleCubeBatch(const float* dirX, const float* dirY, const float* dirZ, vec3* out, const size_t count);
+    void    SampleLatLongBatch(const vec3* dirs, vec3* out, const size_t count);
+    void    SampleLatLongBatch(const float* dirX, const float* dirY, const float* dirZ, vec3* out, const size_t count);
+
+private:
+    // makes sure all the `reps` are valid, deriving the missing ones from the loaded source
+    void    Require(const uint32_t reps);
+    // drops everything that was derived from the source, e.g. after a precision change
+    void    InvalidateDerived();
+
+    // Load / Save begin the job rows of one image, Read / Write only add theirs so several images can run at once
+    bool    LoadImage2D(const fs::path& path, Image2D& img);
+    template <typename T>
+    bool    SaveImage2D(const fs::path& path, const ImageViewT<T>& img);
+    bool    ReadImage2D(const fs::path& path, Image2D& img);
+    bool    ReadLdrImage2D(const fs::path& path, Image2D& img);
+    bool    WriteImage2D(const fs::path& path, const ImageView& img);
+    bool    WriteImage2D(const fs::path& path, const ImageView8& img);
+    bool    WriteImage2D(const fs::path& path, const ImageView16& img);
+    // packed RGB8 to the stb encoder of the extension
+    bool    WriteLdrPixels(const fs::path& path, const size_t width, const size_t height, const uint8_t* pixels);
+    // from the file header only
+    static bool GetImage2DSize(const fs::path& path, size_t& width, size_t& height);
+
+    static ImageView MakeImageView(Image2D& img);
+    static void DecodeLdrImage2D(Image2D& img);
+
+    // LDR source, LDR file and export settings that leave [0, 1] as is
+    bool    IsLdrPassThrough(const fs::path& path) const;
+
+    vec3    SampleImage2D(const Image2D& img, const float u, const float v) const;
+    vec3    SampleImage2D(const ImageView& img, const float u, const float v) const;
+    static CubeFace ProjectToCubeFace(const vec3& dir, vec2& faceUv);
+
+    const LatLongTrigTables& GetLatLongTrigTables(const size_t width, const size_t height);
+
+    // source uv of one output row, shared by the direct conversions and the remap table builders
+    void    LatLongToCubeFacesRowUv(const size_t face, const size_t y, const size_t faceWidth, const size_t faceHeight, float* rowScratch) const;
+    void    CubeFacesToLatLongRowUv(const LatLongTrigTables& trig, const size_t y, uint8_t* rowFaces, float* rowScratch) const;
+
+    bool    IsJobCancelled() const;
+    void    BeginJobRows(const size_t numRows);
+    void    ReportJobRows(const size_t numRows);
+
+    // Built or found in the cache, shared by the float and LDR conversions. nullptr if the build got cancelled.
+    std::shared_ptr<const RemapTable> FindLatLongToCubeFacesTable(const size_t latLongWidth, const size_t latLongHeight);
+    std::shared_ptr<const RemapTable> FindCubeFacesToLatLongTable(const size_t faceWidth, const size_t faceHeight);
+
+    // false if cancelled
+    bool    LatLongToCubeFaces();
+    void    CubeCrossToCubeFaces();
+    bool    CubeFacesToLatLong();
+    bool    LatLongToCubeFacesLdr();
+    bool    CubeFacesToLatLongLdr();
+
+private:
+    Image2D         mLatLong;
+    Image2D         mCubeCross;
+    Array<ImageView> mCubeFaces;    // views into mCubeCross, the faces are never stored twice
+    Array<ImageView8> mCubeFaces8;
+    Array<ImageView16> mCubeFaces16;
+
+    // kept across loads, images of the same size are the common case
+    LatLongTrigTables mLatLongTrig;
+
+    MathPrecision   mMathPrecision;
+    LdrExportSettings mLdrExport;
+    JobProgress*    mJobProgress;
+
+    uint32_t                mRevision;
+    Representation          mSource;        // what was loaded
+    std::atomic<uint32_t>   mValidReps;
+    std::mutex              mDeriveLock;
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+
+
+enum class ImageOrientation {
+    Normal,
+    Rotated180
+};
+
+// sRGB encoded texels of the LDR files, kept at the precision the file stores them in (LdrPixels.h)
+struct Rgb8 {
+    uint8_t     r, g, b;
+};
+
+struct Rgb16 {
+    uint16_t    r, g, b;
+};
+
+// Non-owning, strided window into an RGB image buffer, float (ImageView) or LDR texels.
+// `data` points at the top-left texel of the window as it is stored in the buffer, for a
+// Rotated180 view that texel is the view's bottom-right one (-Z face of the vertical cross).
+template <typename T>
+struct ImageViewT {
+    T*                  data;
+    size_t              width;
+    size_t              height;
+    size_t              stride;         // in texels, between two rows of the underlying buffer
+    ImageOrientation    orientation;
+
+    size_t TexelIndex(const size_t x, const size_t y) const {
+        if (orientation == ImageOrientation::Rotated180) {
+            return (height - 1 - y) * stride + (width - 1 - x);
+        } else {
+            return y * stride + x;
+        }
+    }
+
+    T& Texel(const size_t x, const size_t y) const {
+        return data[this->TexelIndex(x, y)];
+    }
+
+    // texel (0, y) and the distance to the next texel of the same row
+    T* RowBegin(const size_t y) const {
+        return data + this->TexelIndex(0, y);
+    }
+    ptrdiff_t TexelStep() const {
+        return (orientation == ImageOrientation::Rotated180) ? -1 : 1;
+    }
+
+    // rows follow each other in memory in view order, can be handed to APIs that want a plain pixel array
+    bool IsContiguous() const {
+        return stride == width && orientation == ImageOrientation::Normal;
+    }
+};
+
+using ImageView = ImageViewT<vec3>;
+using ImageView8 = ImageViewT<Rgb8>;
+using ImageView16 = ImageViewT<Rgb16>;
@@ -0,0 +1,76 @@
+#include "JobProgress.h"
+
+
+JobProgress::JobProgress()
+    : mProgress(0.0f)
+    , mCancelled(false)
+    , mRangeBegin(0.0f)
+    , mRangeEnd(1.0f)
+    , mItemsDone(0)
+    , mItemsTotal(0)
+{
+}
+
+void JobProgress::Cancel() {
+    mCancelled = true;
+}
+
+bool JobProgress::IsCancelled() const {
+    return mCancelled.load(std::memory_order_relaxed);
+}
+
+float JobProgress::GetProgress() const {
+    return mProgress.load(std::memory_order_relaxed);
+}
+
+void JobProgress::SetRange(const float begin, const float end) {
+    mRangeBegin = begin;
+    mRangeEnd = end;
+}
+
+float JobProgress::GetRangeBegin() const {
+    return mRangeBegin;
+}
+
+float JobProgress::GetRangeEnd() const {
+    return mRangeEnd;
+}
+
+void JobProgress::SetFraction(const float fraction) {
+    mProgress.store(mRangeBegin + (mRangeEnd - mRangeBegin) * Clamp(fraction, 0.0f, 1.0f), std::memory_order_relaxed);
+}
+
+void JobProgress::BeginItems(const size_t total) {
+    mItemsTotal = total;
+    mItemsDone = 0;
+    this->SetFraction(0.0f);
+}
+
+void JobProgress::AddItems(const size_t count) {
+    const size_t done = mItemsDone.fetch_add(count) + count;
+    if (mItemsTotal) {
+        this->SetFraction(scast<float>(done) / scast<float>(mItemsTotal));
+    }
+}
+
+
+JobProgressScope::JobProgressScope(JobProgress* progress, const float from, const float to)
+    : mProgress(progress)
+    , mOuterBegin(0.0f)
+    , mOuterEnd(1.0f)
+{
+    if (mProgress) {
+        mOuterBegin = mProgress->GetRangeBegin();
+        mOuterEnd = mProgress->GetRangeEnd();
+
+        const float outerSize = mOuterEnd - mOuterBegin;
+        mProgress->SetRange(mOuterBegin + outerSize * from, mOuterBegin + outerSize * to);
+        mProgress->SetFraction(0.0f);
+    }
+}
+JobProgressScope::~JobProgressScope() {
+    if (mProgress) {
+        mProgress->SetFraction(1.0f);
+        mProgress->SetRange(mOuterBegin, mOuterEnd);
+    }
+}
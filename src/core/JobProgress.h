@@ -0,0 +1,53 @@
+#pragma once
+#include "mycommon.h"
+
+#include <atomic>
+
+
+// Progress and cancellation of a long running job, shared between the job and whoever watches it.
+//
+// The job is split into nested steps with JobProgressScope, every step reports into its own
+// [begin, end] range of the whole job, so the code doing the work only ever reports 0..1 of itself.
+// Cancellation is cooperative: the work checks IsCancelled() between tiles / rows / files.
+class JobProgress {
+public:
+    JobProgress();
+
+    void    Cancel();
+    bool    IsCancelled() const;
+
+    // 0..1 of the whole job
+    float   GetProgress() const;
+
+    void    SetRange(const float begin, const float end);
+    float   GetRangeBegin() const;
+    float   GetRangeEnd() const;
+
+    // of the current range
+    void    SetFraction(const float fraction);
+
+    // Item counting within the current range, AddItems is safe to call from several threads
+    void    BeginItems(const size_t total);
+    void    AddItems(const size_t count);
+
+private:
+    std::atomic<float>  mProgress;
+    std::atomic<bool>   mCancelled;
+    float               mRangeBegin;
+    float               mRangeEnd;
+    std::atomic<size_t> mItemsDone;
+    size_t              mItemsTotal;
+};
+
+// Narrows the reported range to [from, to] of the current one, restores it (as finished) when done.
+// A null progress is fine, everything turns into no-ops then.
+class JobProgressScope {
+public:
+    JobProgressScope(JobProgress* progress, const float from, const float to);
+    ~JobProgressScope();
+
+private:
+    JobProgress*    mProgress;
+    float           mOuterBegin;
+    float           mOuterEnd;
+};
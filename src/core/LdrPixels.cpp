@@ -0,0 +1,140 @@
+#include "LdrPixels.h"
+#include "RemapTable.h"
+
+#include <cmath>
+
+
+// Bilinear weights in fixed point, 16 bit linear * 2^15 leaves room for the rounding in 32 bits
+static const uint32_t sWeightBits = 15;
+static const float sWeightScale = scast<float>(1u << sWeightBits);
+static const uint32_t sWeightHalf = 1u << (sWeightBits - 1);
+
+static const uint32_t sMaxLinear = 65535;
+
+
+static double SrgbToLinear(const double x) {
+    return (x <= 0.04045) ? (x / 12.92) : std::pow((x + 0.055) / 1.055, 2.4);
+}
+
+static double LinearToSrgb(const double x) {
+    return (x <= 0.0031308) ? (x * 12.92) : (1.055 * std::pow(x, 1.0 / 2.4) - 0.055);
+}
+
+namespace {
+
+// per sRGB code of one bit depth
+struct DecodeTables {
+    Array<float>    toFloat;
+    Array<uint16_t> toLinear;
+};
+
+} // namespace
+
+static DecodeTables MakeDecodeTables(const size_t numCodes) {
+    const double maxCode = scast<double>(numCodes - 1);
+
+    DecodeTables tables;
+    tables.toFloat.resize(numCodes);
+    tables.toLinear.resize(numCodes);
+    for (size_t i = 0; i < numCodes; ++i) {
+        const double linear = SrgbToLinear(scast<double>(i) / maxCode);
+        tables.toFloat[i] = scast<float>(linear);
+        tables.toLinear[i] = scast<uint16_t>(std::floor(linear * sMaxLinear + 0.5));
+    }
+    return tables;
+}
+
+static const DecodeTables& GetDecodeTables(const Rgb8*) {
+    static const DecodeTables tables = MakeDecodeTables(256);
+    return tables;
+}
+
+static const DecodeTables& GetDecodeTables(const Rgb16*) {
+    static const DecodeTables tables = MakeDecodeTables(65536);
+    return tables;
+}
+
+// 16 bit linear -> nearest 8 bit sRGB code, 64 KB
+static const uint8_t* GetEncodeTable() {
+    static const Array<uint8_t> table = [] {
+        Array<uint8_t> result(sMaxLinear + 1);
+        for (size_t i = 0; i <= sMaxLinear; ++i) {
+            const double srgb = LinearToSrgb(scast<double>(i) / sMaxLinear);
+            result[i] = scast<uint8_t>(std::floor(srgb * 255.0 + 0.5));
+        }
+        return result;
+    }();
+    return table.data();
+}
+
+template <typename Texel>
+static void DecodeTexels(const Texel* src, const ptrdiff_t srcStep, const size_t count, vec3* dst) {
+    const float* toFloat = GetDecodeTables(src).toFloat.data();
+    for (size_t x = 0; x < count; ++x, src += srcStep) {
+        dst[x] = vec3(toFloat[src->r], toFloat[src->g], toFloat[src->b]);
+    }
+}
+
+template <typename Texel>
+static void RemapTexels(const Texel* src, const RemapTap* taps, const size_t count, Rgb8* dst, const ptrdiff_t dstStep) {
+    const uint16_t* toLinear = GetDecodeTables(src).toLinear.data();
+    const uint8_t* toSrgb = GetEncodeTable();
+
+    for (size_t x = 0; x < count; ++x, dst += dstStep) {
+        const RemapTap& tap = taps[x];
+
+        // the first weight takes what the others leave, so they always sum up to exactly one
+        uint32_t weights[4];
+        weights[1] = scast<uint32_t>(Maximum(tap.weight[1], 0.0f) * sWeightScale + 0.5f);
+        weights[2] = scast<uint32_t>(Maximum(tap.weight[2], 0.0f) * sWeightScale + 0.5f);
+        weights[3] = scast<uint32_t>(Maximum(tap.weight[3], 0.0f) * sWeightScale + 0.5f);
+        const uint32_t others = weights[1] + weights[2] + weights[3];
+        weights[0] = (others < (1u << sWeightBits)) ? (1u << sWeightBits) - others : 0;
+
+        uint32_t r = sWeightHalf, g = sWeightHalf, b = sWeightHalf;
+        for (size_t i = 0; i < 4; ++i) {
+            const Texel& texel = src[tap.index[i]];
+            r += toLinear[texel.r] * weights[i];
+            g += toLinear[texel.g] * weights[i];
+            b += toLinear[texel.b] * weights[i];
+        }
+
+        dst->r = toSrgb[Minimum(r >> sWeightBits, sMaxLinear)];
+        dst->g = toSrgb[Minimum(g >> sWeightBits, sMaxLinear)];
+        dst->b = toSrgb[Minimum(b >> sWeightBits, sMaxLinear)];
+    }
+}
+
+
+void DecodeLdrTexels(const Rgb8* src, const ptrdiff_t srcStep, const size_t count, vec3* dst) {
+    DecodeTexels(src, srcStep, count, dst);
+}
+
+void DecodeLdrTexels(const Rgb16* src, const ptrdiff_t srcStep, const size_t count, vec3* dst) {
+    DecodeTexels(src, srcStep, count, dst);
+}
+
+void RemapLdrTexels(const Rgb8* src, const RemapTap* taps, const size_t count, Rgb8* dst, const ptrdiff_t dstStep) {
+    RemapTexels(src, taps, count, dst, dstStep);
+}
+
+void RemapLdrTexels(const Rgb16* src, const RemapTap* taps, const size_t count, Rgb8* dst, const ptrdiff_t dstStep) {
+    RemapTexels(src, taps, count, dst, dstStep);
+}
+
+void PackLdrTexels(const Rgb8* src, const ptrdiff_t srcStep, const size_t count, uint8_t* dst) {
+    for (size_t x = 0; x < count; ++x, src += srcStep, dst += 3) {
+        dst[0] = src->r;
+        dst[1] = src->g;
+        dst[2] = src->b;
+    }
+}
+
+void PackLdrTexels(const Rgb16* src, const ptrdiff_t srcStep, const size_t count, uint8_t* dst) {
+    // v * 255 / 65535 = v / 257, rounded
+    for (size_t x = 0; x < count; ++x, src += srcStep, dst += 3) {
+        dst[0] = scast<uint8_t>((src->r + 128u) / 257u);
+        dst[1] = scast<uint8_t>((src->g + 128u) / 257u);
+        dst[2] = scast<uint8_t>((src->b + 128u) / 257u);
+    }
+}
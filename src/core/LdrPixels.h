@@ -0,0 +1,25 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+#include "ImageView.h"
+
+struct RemapTap;
+
+
+// The sRGB encoded 8 / 16 bit texels of the LDR files (.png, .jpg, .tga, .bmp) are kept as they are,
+// an LDR -> LDR conversion never goes through floats. Linear light only comes in where the filtering
+// needs it, and all of the curve is table driven:
+//   decode  - sRGB -> linear float, 256 / 65536 entries of the exact curve
+//   remap   - sRGB -> 16 bit linear, 15 bit fixed point bilinear weights, 16 bit linear -> 8 bit sRGB
+//   pack    - into the packed RGB8 the encoders take, 16 bit texels rounded to 8 in the sRGB domain
+// Every call walks `count` texels, `step` apart on the strided side (-1 walks a rotated row backwards).
+
+void    DecodeLdrTexels(const Rgb8* src, const ptrdiff_t srcStep, const size_t count, vec3* dst);
+void    DecodeLdrTexels(const Rgb16* src, const ptrdiff_t srcStep, const size_t count, vec3* dst);
+
+// taps index `src`, the output is always 8 bit as that's all the encoders write
+void    RemapLdrTexels(const Rgb8* src, const RemapTap* taps, const size_t count, Rgb8* dst, const ptrdiff_t dstStep);
+void    RemapLdrTexels(const Rgb16* src, const RemapTap* taps, const size_t count, Rgb8* dst, const ptrdiff_t dstStep);
+
+void    PackLdrTexels(const Rgb8* src, const ptrdiff_t srcStep, const size_t count, uint8_t* dst);
+void    PackLdrTexels(const Rgb16* src, const ptrdiff_t srcStep, const size_t count, uint8_t* dst);
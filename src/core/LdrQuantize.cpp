@@ -0,0 +1,378 @@
+#include "LdrQuantize.h"
+#include "mymath_simd.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#if MM_SIMD_X64
+#include <emmintrin.h>
+#endif
+
+static const char* sToneMapOperatorNames[] = {
+    "clamp", "reinhard", "aces"
+};
+
+static const char* sDitherModeNames[] = {
+    "none", "ordered", "bluenoise"
+};
+
+// Narkowicz 2015, (x * (a * x + b)) / (x * (c * x + d) + e)
+static const float sAcesA = 2.51f;
+static const float sAcesB = 0.03f;
+static const float sAcesC = 2.43f;
+static const float sAcesD = 0.59f;
+static const float sAcesE = 0.14f;
+
+// the largest float below 1, the table lookup of 1.0 would run past the last entry
+static const uint32_t sAlmostOneBits = 0x3F7FFFFFu;
+
+// sRGB: linear segment up to here, 1.055 * x^(1 / 2.4) - 0.055 above
+static const float sSrgbLinearEnd = 0.0031308f;
+static const float sSrgbLinearScale = 12.92f * 255.0f;
+
+// The power segment is a table over [2^-9, 1), below the linear segment takes over anyway.
+// 32 entries per octave (the top 5 mantissa bits), interpolated linearly by the next 18 bits.
+static const uint32_t sSrgbTableMinBits = (127u - 9u) << 23;
+static const uint32_t sSrgbTableShift = 18;
+static const uint32_t sSrgbTableFractionMask = (1u << sSrgbTableShift) - 1;
+static const float sSrgbTableFractionScale = 1.0f / scast<float>(1u << sSrgbTableShift);
+static const size_t sSrgbTableSize = 9 * 32;
+
+// dither threshold maps, the 8x8 Bayer matrix is tiled to the same size
+static const size_t sDitherMapSize = 64;
+
+
+static uint32_t FloatBits(const float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float BitsFloat(const uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+namespace {
+
+// 255 * sRGB(x) = base + slope * t over every table span
+struct SrgbTable {
+    float   base[sSrgbTableSize];
+    float   slope[sSrgbTableSize];
+};
+
+} // namespace
+
+static SrgbTable MakeSrgbTable() {
+    auto encode255 = [](const double x) {
+        return 255.0 * (1.055 * std::pow(x, 1.0 / 2.4) - 0.055);
+    };
+
+    SrgbTable table;
+    for (size_t i = 0; i < sSrgbTableSize; ++i) {
+        const double x0 = BitsFloat(sSrgbTableMinBits + scast<uint32_t>(i << sSrgbTableShift));
+        const double x1 = BitsFloat(sSrgbTableMinBits + scast<uint32_t>((i + 1) << sSrgbTableShift));
+        table.base[i] = scast<float>(encode255(x0));
+        table.slope[i] = scast<float>(encode255(x1) - encode255(x0));
+    }
+    return table;
+}
+
+static const SrgbTable& GetSrgbTable() {
+    static const SrgbTable table = MakeSrgbTable();
+    return table;
+}
+
+static Array<float> MakeOrderedDitherMap() {
+    // M(2n) = | 4M     4M + 2 |
+    //         | 4M + 3 4M + 1 |
+    uint32_t bayer[8][8] = {};
+    for (size_t size = 1; size < 8; size *= 2) {
+        for (size_t y = 0; y < size; ++y) {
+            for (size_t x = 0; x < size; ++x) {
+                const uint32_t v = bayer[y][x] * 4;
+                bayer[y][x] = v;
+                bayer[y][x + size] = v + 2;
+                bayer[y + size][x] = v + 3;
+                bayer[y + size][x + size] = v + 1;
+            }
+        }
+    }
+
+    Array<float> map(sDitherMapSize * sDitherMapSize);
+    for (size_t y = 0; y < sDitherMapSize; ++y) {
+        for (size_t x = 0; x < sDitherMapSize; ++x) {
+            map[y * sDitherMapSize + x] = (scast<float>(bayer[y & 7][x & 7]) + 0.5f) / 64.0f;
+        }
+    }
+    return map;
+}
+
+// Void-and-cluster (Ulichney 1993) on a torus, Gaussian energy with sigma 1.5.
+// The upper half is ranked by filling the largest voids too instead of the inverted clusters,
+// a bit less even at high densities but one code path.
+static Array<float> MakeBlueNoiseMap() {
+    const size_t size = sDitherMapSize;
+    const size_t count = size * size;
+    const float sigma = 1.5f;
+
+    Array<float> kernel(count);
+    for (size_t y = 0; y < size; ++y) {
+        for (size_t x = 0; x < size; ++x) {
+            const float dx = scast<float>(Minimum(x, size - x));
+            const float dy = scast<float>(Minimum(y, size - y));
+            kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+        }
+    }
+
+    Array<uint8_t> pattern(count, 0);
+    Array<float> energy(count, 0.0f);
+
+    auto splat = [&](const size_t p, const float sign) {
+        const size_t px = p % size;
+        const size_t py = p / size;
+        for (size_t y = 0; y < size; ++y) {
+            const float* kernelRow = kernel.data() + ((y - py) & (size - 1)) * size;
+            float* energyRow = energy.data() + y * size;
+            for (size_t x = 0; x < size; ++x) {
+                energyRow[x] += sign * kernelRow[(x - px) & (size - 1)];
+            }
+        }
+    };
+    auto findExtreme = [&](const uint8_t value, const bool highest) {
+        size_t best = kInvalidValue;
+        for (size_t i = 0; i < count; ++i) {
+            if (pattern[i] == value && (best == kInvalidValue || (highest ? energy[i] > energy[best] : energy[i] < energy[best]))) {
+                best = i;
+            }
+        }
+        return best;
+    };
+    auto set = [&](const size_t p, const uint8_t value) {
+        pattern[p] = value;
+        splat(p, value ? 1.0f : -1.0f);
+    };
+
+    // random 10% to start with, moved from the tightest cluster into the largest void until that's the same spot
+    // (converges in well under `count` moves)
+    const size_t numInitial = count / 10;
+    std::mt19937 rng(1);
+    for (size_t i = 0; i < numInitial;) {
+        const size_t p = rng() % count;
+        if (!pattern[p]) {
+            set(p, 1);
+            ++i;
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        const size_t cluster = findExtreme(1, true);
+        set(cluster, 0);
+        const size_t largestVoid = findExtreme(0, false);
+        set(largestVoid, 1);
+        if (largestVoid == cluster) {
+            break;
+        }
+    }
+
+    const Array<uint8_t> initialPattern = pattern;
+    const Array<float> initialEnergy = energy;
+
+    Array<size_t> rank(count);
+    // the initial points, ranked by taking the tightest cluster away
+    for (size_t r = numInitial; r-- > 0;) {
+        const size_t cluster = findExtreme(1, true);
+        set(cluster, 0);
+        rank[cluster] = r;
+    }
+
+    // everything else by filling the largest void
+    pattern = initialPattern;
+    energy = initialEnergy;
+    for (size_t r = numInitial; r < count; ++r) {
+        const size_t largestVoid = findExtreme(0, false);
+        set(largestVoid, 1);
+        rank[largestVoid] = r;
+    }
+
+    Array<float> map(count);
+    for (size_t i = 0; i < count; ++i) {
+        map[i] = (scast<float>(rank[i]) + 0.5f) / scast<float>(count);
+    }
+    return map;
+}
+
+// nullptr for no dithering
+static const float* GetDitherMap(const DitherMode mode) {
+    if (mode == DitherMode::Ordered) {
+        static const Array<float> orderedMap = MakeOrderedDitherMap();
+        return orderedMap.data();
+    } else if (mode == DitherMode::BlueNoise) {
+        static const Array<float> blueNoiseMap = MakeBlueNoiseMap();
+        return blueNoiseMap.data();
+    }
+    return nullptr;
+}
+
+
+static float ToneMap(const float v, const ToneMapOperator op) {
+    switch (op) {
+        case ToneMapOperator::Reinhard: return v / (1.0f + v);
+        case ToneMapOperator::ACES:     return (v * (sAcesA * v + sAcesB)) / (v * (sAcesC * v + sAcesD) + sAcesE);
+        default:                        return v;
+    }
+}
+
+// [0, 1) -> [0, 255]
+static float EncodeSrgb255(const float v, const SrgbTable& table) {
+    if (v <= sSrgbLinearEnd) {
+        return v * sSrgbLinearScale;
+    }
+
+    const uint32_t bits = FloatBits(v);
+    const uint32_t index = (bits - sSrgbTableMinBits) >> sSrgbTableShift;
+    const float t = scast<float>(bits & sSrgbTableFractionMask) * sSrgbTableFractionScale;
+    return table.base[index] + table.slope[index] * t;
+}
+
+static uint8_t QuantizeChannel(const float value, const float scale, const LdrExportSettings& settings, const SrgbTable& table, const float threshold) {
+    // NaN -> 0, the comparisons are ordered the same as the SSE min/max below
+    float v = value * scale;
+    v = (v > 0.0f) ? v : 0.0f;
+    v = ToneMap(v, settings.toneMap);
+    v = (v < BitsFloat(sAlmostOneBits)) ? v : BitsFloat(sAlmostOneBits);
+
+    const float encoded = settings.sRGB ? EncodeSrgb255(v, table) : v * 255.0f;
+    return scast<uint8_t>(Minimum(scast<int32_t>(encoded + threshold), 255));
+}
+
+
+#if MM_SIMD_X64
+namespace {
+
+__m128 ToneMap4(const __m128 v, const ToneMapOperator op) {
+    switch (op) {
+        case ToneMapOperator::Reinhard:
+            return _mm_div_ps(v, _mm_add_ps(_mm_set1_ps(1.0f), v));
+        case ToneMapOperator::ACES: {
+            const __m128 numerator = _mm_mul_ps(v, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(sAcesA), v), _mm_set1_ps(sAcesB)));
+            const __m128 denominator = _mm_add_ps(_mm_mul_ps(v, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(sAcesC), v), _mm_set1_ps(sAcesD))), _mm_set1_ps(sAcesE));
+            return _mm_div_ps(numerator, denominator);
+        }
+        default:
+            return v;
+    }
+}
+
+__m128 EncodeSrgb255x4(const __m128 v, const SrgbTable& table) {
+    const __m128 linear = _mm_mul_ps(v, _mm_set1_ps(sSrgbLinearScale));
+
+    // the lanes of the linear segment still need an index in range
+    const __m128i bits = _mm_castps_si128(_mm_max_ps(v, _mm_set1_ps(BitsFloat(sSrgbTableMinBits))));
+    alignas(16) uint32_t index[4];
+    _mm_store_si128(rcast<__m128i*>(index), _mm_srli_epi32(_mm_sub_epi32(bits, _mm_set1_epi32(sSrgbTableMinBits)), sSrgbTableShift));
+
+    const __m128 base = _mm_setr_ps(table.base[index[0]], table.base[index[1]], table.base[index[2]], table.base[index[3]]);
+    const __m128 slope = _mm_setr_ps(table.slope[index[0]], table.slope[index[1]], table.slope[index[2]], table.slope[index[3]]);
+    const __m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(bits, _mm_set1_epi32(sSrgbTableFractionMask))), _mm_set1_ps(sSrgbTableFractionScale));
+    const __m128 curve = _mm_add_ps(base, _mm_mul_ps(slope, t));
+
+    const __m128 isLinear = _mm_cmple_ps(v, _mm_set1_ps(sSrgbLinearEnd));
+    return _mm_or_ps(_mm_and_ps(isLinear, linear), _mm_andnot_ps(isLinear, curve));
+}
+
+// the 4 results in the low 4 bytes
+uint32_t QuantizeChannel4(const __m128 value, const __m128 scale, const LdrExportSettings& settings, const SrgbTable& table, const __m128 threshold) {
+    // _mm_max_ps / _mm_min_ps return the second operand for a NaN
+    __m128 v = _mm_max_ps(_mm_mul_ps(value, scale), _mm_setzero_ps());
+    v = ToneMap4(v, settings.toneMap);
+    v = _mm_min_ps(v, _mm_set1_ps(BitsFloat(sAlmostOneBits)));
+
+    const __m128 encoded = settings.sRGB ? EncodeSrgb255x4(v, table) : _mm_mul_ps(v, _mm_set1_ps(255.0f));
+    const __m128i q = _mm_cvttps_epi32(_mm_add_ps(encoded, threshold));
+    return scast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(q, q), q)));
+}
+
+} // namespace
+#endif
+
+
+LdrExportSettings GetDefaultLdrExportSettings() {
+    return { 0.0f, ToneMapOperator::Clamp, true, DitherMode::None };
+}
+
+bool IsPassThroughLdrExport(const LdrExportSettings& settings) {
+    return settings.exposure == 0.0f &&
+           settings.toneMap == ToneMapOperator::Clamp &&
+           settings.sRGB &&
+           settings.dither == DitherMode::None;
+}
+
+const char* GetToneMapOperatorName(const ToneMapOperator op) {
+    return sToneMapOperatorNames[scast<size_t>(op)];
+}
+
+const char* GetDitherModeName(const DitherMode mode) {
+    return sDitherModeNames[scast<size_t>(mode)];
+}
+
+bool ParseToneMapOperator(const String& name, ToneMapOperator& op) {
+    for (size_t i = 0; i < std::size(sToneMapOperatorNames); ++i) {
+        if (name == sToneMapOperatorNames[i]) {
+            op = scast<ToneMapOperator>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseDitherMode(const String& name, DitherMode& mode) {
+    for (size_t i = 0; i < std::size(sDitherModeNames); ++i) {
+        if (name == sDitherModeNames[i]) {
+            mode = scast<DitherMode>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void QuantizeLdrRow(const vec3* src, const ptrdiff_t srcStep, const size_t count, const size_t y, const LdrExportSettings& settings, uint8_t* dst) {
+    const SrgbTable& table = GetSrgbTable();
+    const float scale = std::exp2(settings.exposure);
+
+    const float* ditherMap = GetDitherMap(settings.dither);
+    const float* ditherRow = ditherMap ? ditherMap + (y % sDitherMapSize) * sDitherMapSize : nullptr;
+
+    size_t x = 0;
+
+#if MM_SIMD_X64
+    const __m128 scale4 = _mm_set1_ps(scale);
+    for (; x + 4 <= count; x += 4, src += srcStep * 4, dst += 12) {
+        const vec3& t0 = src[0];
+        const vec3& t1 = src[srcStep];
+        const vec3& t2 = src[srcStep * 2];
+        const vec3& t3 = src[srcStep * 3];
+
+        // x is a multiple of 4, the 4 thresholds never wrap around the map
+        const __m128 threshold = ditherRow ? _mm_loadu_ps(ditherRow + (x % sDitherMapSize)) : _mm_set1_ps(0.5f);
+
+        const uint32_t r = QuantizeChannel4(_mm_setr_ps(t0.x, t1.x, t2.x, t3.x), scale4, settings, table, threshold);
+        const uint32_t g = QuantizeChannel4(_mm_setr_ps(t0.y, t1.y, t2.y, t3.y), scale4, settings, table, threshold);
+        const uint32_t b = QuantizeChannel4(_mm_setr_ps(t0.z, t1.z, t2.z, t3.z), scale4, settings, table, threshold);
+
+        for (size_t i = 0; i < 4; ++i) {
+            dst[i * 3 + 0] = scast<uint8_t>(r >> (i * 8));
+            dst[i * 3 + 1] = scast<uint8_t>(g >> (i * 8));
+            dst[i * 3 + 2] = scast<uint8_t>(b >> (i * 8));
+        }
+    }
+#endif
+
+    for (; x < count; ++x, src += srcStep, dst += 3) {
+        const float threshold = ditherRow ? ditherRow[x % sDitherMapSize] : 0.5f;
+        dst[0] = QuantizeChannel(src->x, scale, settings, table, threshold);
+        dst[1] = QuantizeChannel(src->y, scale, settings, table, threshold);
+        dst[2] = QuantizeChannel(src->z, scale, settings, table, threshold);
+    }
+}
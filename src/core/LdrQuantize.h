@@ -0,0 +1,41 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+
+
+// HDR -> 8 bit conversion of the LDR exports, per channel:
+//   * 2^exposure -> tone map -> clamp to [0, 1] -> transfer curve -> + dither threshold -> floor
+// Negatives and NaNs turn to 0, the result never wraps.
+enum class ToneMapOperator {
+    Clamp,      // everything above 1 clips
+    Reinhard,   // x / (1 + x)
+    ACES        // Narkowicz's fit of the ACES filmic curve
+};
+
+enum class DitherMode {
+    None,       // round to nearest
+    Ordered,    // 8x8 Bayer matrix
+    BlueNoise   // 64x64 void-and-cluster threshold map
+};
+
+struct LdrExportSettings {
+    float           exposure;   // in stops
+    ToneMapOperator toneMap;
+    bool            sRGB;       // sRGB transfer curve, otherwise stored linear
+    DitherMode      dither;
+};
+
+// no exposure, clamp, sRGB, no dithering
+LdrExportSettings GetDefaultLdrExportSettings();
+// the defaults leave sRGB values in [0, 1] as they are, so LDR sources can skip the quantizer
+bool        IsPassThroughLdrExport(const LdrExportSettings& settings);
+
+const char* GetToneMapOperatorName(const ToneMapOperator op);
+const char* GetDitherModeName(const DitherMode mode);
+bool        ParseToneMapOperator(const String& name, ToneMapOperator& op);
+bool        ParseDitherMode(const String& name, DitherMode& mode);
+
+// Row `y` of an image (dither position), `count` texels `srcStep` apart (-1 walks a rotated row backwards)
+// into packed RGB8. The sRGB curve is a table with linear interpolation, within 0.01 of a step of the exact one.
+// SSE2 on x64 and bit-identical to the scalar path.
+void        QuantizeLdrRow(const vec3* src, const ptrdiff_t srcStep, const size_t count, const size_t y, const LdrExportSettings& settings, uint8_t* dst);
@@ -0,0 +1,270 @@
+#include "PixelPacking.h"
+#include "mymath_simd.h"
+
+#include <cstring>
+
+#if MM_SIMD_X64
+#include <emmintrin.h>
+#endif
+
+// Largest finite values of the small float formats: (2 - 2^-M) * 2^15
+static const float sMaxHalf = 65504.0f;         // M = 10
+static const float sMaxFloat11 = 65024.0f;      // M = 6
+static const float sMaxFloat10 = 64512.0f;      // M = 5
+// RGB9E5: (2^9 - 1) / 2^9 * 2^(31 - 15)
+static const float sMaxRGB9E5 = 65408.0f;
+
+// below this the small floats (5 bit exponent, bias 15) are denormals
+static const float sMinNormal = 1.0f / 16384.0f;
+
+
+static uint32_t FloatBits(const float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float BitsFloat(const uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// NaN -> 0, the comparisons are ordered the same as the SSE min/max below
+static float ClampUnsigned(const float value, const float maxValue) {
+    const float v = (value > 0.0f) ? value : 0.0f;
+    return (v < maxValue) ? v : maxValue;
+}
+
+// Clamped value -> unsigned float with a 5 bit exponent and M bit mantissa.
+// Rounding a normal is done on the bits, the carry walks into the exponent by itself,
+// the same way a denormal that rounds up to (1 << M) becomes the smallest normal.
+template <uint32_t M>
+static uint32_t PackSmallFloat(const float value) {
+    if (value < sMinNormal) {
+        return scast<uint32_t>(value * scast<float>(1u << (14 + M)) + 0.5f);
+    } else {
+        return (FloatBits(value) - ((127u - 15u) << 23) + (1u << (22 - M))) >> (23 - M);
+    }
+}
+
+// floor(log2(maxc)) clamped to -16, biased by 16, straight from the float exponent
+static uint32_t SharedExponent(const float maxComponent) {
+    const int32_t exponent = scast<int32_t>(FloatBits(maxComponent) >> 23) - 111;
+    return scast<uint32_t>(Maximum(exponent, 0));
+}
+
+// 2^(B + N - exponent), a power of two so the scaling is exact
+static float SharedExponentScale(const uint32_t exponent) {
+    return BitsFloat((127u + 24u - exponent) << 23);
+}
+
+
+size_t GetPackedTexelSize(const PackedFormat format) {
+    switch (format) {
+        case PackedFormat::RGBA16F:     return sizeof(uint16_t) * 4;
+        case PackedFormat::R11G11B10F:  return sizeof(uint32_t);
+        case PackedFormat::RGB9E5:      return sizeof(uint32_t);
+        default:                        return sizeof(vec3);
+    }
+}
+
+const char* GetPackedFormatName(const PackedFormat format) {
+    switch (format) {
+        case PackedFormat::RGBA16F:     return "RGBA16F";
+        case PackedFormat::R11G11B10F:  return "R11G11B10F";
+        case PackedFormat::RGB9E5:      return "RGB9E5";
+        default:                        return "RGB32F";
+    }
+}
+
+uint16_t PackHalf(const float value) {
+    const uint32_t sign = (FloatBits(value) >> 16) & 0x8000u;
+    return scast<uint16_t>(sign | PackSmallFloat<10>(ClampUnsigned(std::fabs(value), sMaxHalf)));
+}
+
+uint32_t PackR11G11B10F(const vec3& rgb) {
+    const uint32_t r = PackSmallFloat<6>(ClampUnsigned(rgb.x, sMaxFloat11));
+    const uint32_t g = PackSmallFloat<6>(ClampUnsigned(rgb.y, sMaxFloat11));
+    const uint32_t b = PackSmallFloat<5>(ClampUnsigned(rgb.z, sMaxFloat10));
+    return r | (g << 11) | (b << 22);
+}
+
+// EXT_texture_shared_exponent, with floor(log2()) taken from the exponent bits
+uint32_t PackRGB9E5(const vec3& rgb) {
+    const float r = ClampUnsigned(rgb.x, sMaxRGB9E5);
+    const float g = ClampUnsigned(rgb.y, sMaxRGB9E5);
+    const float b = ClampUnsigned(rgb.z, sMaxRGB9E5);
+    const float maxComponent = Maximum(r, Maximum(g, b));
+
+    uint32_t exponent = SharedExponent(maxComponent);
+    // the largest component can round up to 2^9, one more exponent step then
+    if (scast<uint32_t>(maxComponent * SharedExponentScale(exponent) + 0.5f) == 512u) {
+        ++exponent;
+    }
+
+    const float scale = SharedExponentScale(exponent);
+    const uint32_t rm = scast<uint32_t>(r * scale + 0.5f);
+    const uint32_t gm = scast<uint32_t>(g * scale + 0.5f);
+    const uint32_t bm = scast<uint32_t>(b * scale + 0.5f);
+    return rm | (gm << 9) | (bm << 18) | (exponent << 27);
+}
+
+
+#if MM_SIMD_X64
+namespace {
+
+struct Texels4 {
+    __m128 r;
+    __m128 g;
+    __m128 b;
+};
+
+Texels4 LoadTexels4(const vec3* src, const ptrdiff_t step) {
+    const vec3& t0 = src[0];
+    const vec3& t1 = src[step];
+    const vec3& t2 = src[step * 2];
+    const vec3& t3 = src[step * 3];
+    return { _mm_setr_ps(t0.x, t1.x, t2.x, t3.x), _mm_setr_ps(t0.y, t1.y, t2.y, t3.y), _mm_setr_ps(t0.z, t1.z, t2.z, t3.z) };
+}
+
+__m128 ClampUnsigned4(const __m128 value, const float maxValue) {
+    // _mm_max_ps returns the second operand for a NaN
+    return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(maxValue));
+}
+
+__m128i Select4(const __m128i mask, const __m128i a, const __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+template <uint32_t M>
+__m128i PackSmallFloat4(const __m128 value) {
+    const __m128i denormal = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(scast<float>(1u << (14 + M)))), _mm_set1_ps(0.5f)));
+
+    __m128i normal = _mm_sub_epi32(_mm_castps_si128(value), _mm_set1_epi32((127 - 15) << 23));
+    normal = _mm_srli_epi32(_mm_add_epi32(normal, _mm_set1_epi32(1 << (22 - M))), 23 - M);
+
+    const __m128i isDenormal = _mm_castps_si128(_mm_cmplt_ps(value, _mm_set1_ps(sMinNormal)));
+    return Select4(isDenormal, denormal, normal);
+}
+
+__m128i SharedExponentScale4(const __m128i exponent) {
+    return _mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 24), exponent), 23);
+}
+
+__m128i RoundScaled4(const __m128 value, const __m128 scale) {
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), _mm_set1_ps(0.5f)));
+}
+
+void PackRGBA16F4(const Texels4& t, uint16_t* dst) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128i signMask = _mm_set1_epi32(0x8000);
+
+    alignas(16) uint32_t h[3][4];
+    const __m128 channels[3] = { t.r, t.g, t.b };
+    for (size_t c = 0; c < 3; ++c) {
+        const __m128i sign = _mm_and_si128(_mm_srli_epi32(_mm_castps_si128(channels[c]), 16), signMask);
+        const __m128i half = PackSmallFloat4<10>(ClampUnsigned4(_mm_and_ps(channels[c], absMask), sMaxHalf));
+        _mm_store_si128(rcast<__m128i*>(h[c]), _mm_or_si128(sign, half));
+    }
+
+    for (size_t i = 0; i < 4; ++i, dst += 4) {
+        dst[0] = scast<uint16_t>(h[0][i]);
+        dst[1] = scast<uint16_t>(h[1][i]);
+        dst[2] = scast<uint16_t>(h[2][i]);
+        dst[3] = 0x3C00;    // 1.0
+    }
+}
+
+void PackR11G11B10F4(const Texels4& t, uint32_t* dst) {
+    const __m128i r = PackSmallFloat4<6>(ClampUnsigned4(t.r, sMaxFloat11));
+    const __m128i g = PackSmallFloat4<6>(ClampUnsigned4(t.g, sMaxFloat11));
+    const __m128i b = PackSmallFloat4<5>(ClampUnsigned4(t.b, sMaxFloat10));
+    _mm_storeu_si128(rcast<__m128i*>(dst), _mm_or_si128(r, _mm_or_si128(_mm_slli_epi32(g, 11), _mm_slli_epi32(b, 22))));
+}
+
+void PackRGB9E54(const Texels4& t, uint32_t* dst) {
+    const __m128 r = ClampUnsigned4(t.r, sMaxRGB9E5);
+    const __m128 g = ClampUnsigned4(t.g, sMaxRGB9E5);
+    const __m128 b = ClampUnsigned4(t.b, sMaxRGB9E5);
+    const __m128 maxComponent = _mm_max_ps(r, _mm_max_ps(g, b));
+
+    // max(exponent, 0) without SSE4.1: clear the negative lanes
+    __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxComponent), 23), _mm_set1_epi32(111));
+    exponent = _mm_andnot_si128(_mm_srai_epi32(exponent, 31), exponent);
+
+    const __m128i maxMantissa = RoundScaled4(maxComponent, _mm_castsi128_ps(SharedExponentScale4(exponent)));
+    // the compare mask is -1 in the lanes that need one more exponent step
+    exponent = _mm_sub_epi32(exponent, _mm_cmpeq_epi32(maxMantissa, _mm_set1_epi32(512)));
+
+    const __m128 scale = _mm_castsi128_ps(SharedExponentScale4(exponent));
+    const __m128i rm = RoundScaled4(r, scale);
+    const __m128i gm = RoundScaled4(g, scale);
+    const __m128i bm = RoundScaled4(b, scale);
+
+    __m128i packed = _mm_or_si128(rm, _mm_slli_epi32(gm, 9));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(bm, 18));
+    packed = _mm_or_si128(packed, _mm_slli_epi32(exponent, 27));
+    _mm_storeu_si128(rcast<__m128i*>(dst), packed);
+}
+
+} // namespace
+#endif // MM_SIMD_X64
+
+
+void PackTexels(const vec3* src, const ptrdiff_t srcStep, void* dst, const size_t count, const PackedFormat format) {
+    size_t i = 0;
+
+    switch (format) {
+        case PackedFormat::RGBA16F: {
+            uint16_t* out = scast<uint16_t*>(dst);
+#if MM_SIMD_X64
+            for (; i + 4 <= count; i += 4) {
+                PackRGBA16F4(LoadTexels4(src + scast<ptrdiff_t>(i) * srcStep, srcStep), out + i * 4);
+            }
+#endif
+            for (; i < count; ++i) {
+                const vec3& texel = src[scast<ptrdiff_t>(i) * srcStep];
+                out[i * 4 + 0] = PackHalf(texel.x);
+                out[i * 4 + 1] = PackHalf(texel.y);
+                out[i * 4 + 2] = PackHalf(texel.z);
+                out[i * 4 + 3] = 0x3C00;
+            }
+        } break;
+
+        case PackedFormat::R11G11B10F: {
+            uint32_t* out = scast<uint32_t*>(dst);
+#if MM_SIMD_X64
+            for (; i + 4 <= count; i += 4) {
+                PackR11G11B10F4(LoadTexels4(src + scast<ptrdiff_t>(i) * srcStep, srcStep), out + i);
+            }
+#endif
+            for (; i < count; ++i) {
+                out[i] = PackR11G11B10F(src[scast<ptrdiff_t>(i) * srcStep]);
+            }
+        } break;
+
+        case PackedFormat::RGB9E5: {
+            uint32_t* out = scast<uint32_t*>(dst);
+#if MM_SIMD_X64
+            for (; i + 4 <= count; i += 4) {
+                PackRGB9E54(LoadTexels4(src + scast<ptrdiff_t>(i) * srcStep, srcStep), out + i);
+            }
+#endif
+            for (; i < count; ++i) {
+                out[i] = PackRGB9E5(src[scast<ptrdiff_t>(i) * srcStep]);
+            }
+        } break;
+
+        default: {
+            vec3* out = scast<vec3*>(dst);
+            if (srcStep == 1) {
+                memcpy(out, src, count * sizeof(vec3));
+            } else {
+                for (; i < count; ++i) {
+                    out[i] = src[scast<ptrdiff_t>(i) * srcStep];
+                }
+            }
+        } break;
+    }
+}
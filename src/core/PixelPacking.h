@@ -0,0 +1,27 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+
+
+// Compact texel formats for display / upload, matching the GL packed types bit for bit:
+//   RGB32F      - 12 bytes, the float data as is
+//   RGBA16F     - 8 bytes, halves (alpha = 1), clamped to the largest finite half
+//   R11G11B10F  - 4 bytes, unsigned 6/6/5 bit mantissa floats, GL_UNSIGNED_INT_10F_11F_11F_REV
+//   RGB9E5      - 4 bytes, 9 bit mantissas with a shared exponent, GL_UNSIGNED_INT_5_9_9_9_REV
+// Negatives and NaNs turn to 0 in the unsigned formats, every conversion rounds to nearest.
+enum class PackedFormat {
+    RGB32F,
+    RGBA16F,
+    R11G11B10F,
+    RGB9E5
+};
+
+size_t      GetPackedTexelSize(const PackedFormat format);
+const char* GetPackedFormatName(const PackedFormat format);
+
+uint16_t    PackHalf(const float value);
+uint32_t    PackR11G11B10F(const vec3& rgb);
+uint32_t    PackRGB9E5(const vec3& rgb);
+
+// `count` texels, `srcStep` apart (-1 walks a rotated row backwards), SSE2 on x64 and bit-identical to the scalar packers
+void        PackTexels(const vec3* src, const ptrdiff_t srcStep, void* dst, const size_t count, const PackedFormat format);
@@ -0,0 +1,480 @@
+#include "RadianceHDR.h"
+#include "mymath_simd.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if MM_SIMD_X64
+#include <emmintrin.h>
+#endif
+
+// scanlines decoded / encoded per worker tile
+static const size_t sBandRows = 16;
+// new style RLE is only used for widths in [8, 32768), anything else is flat
+static const size_t sMinRleWidth = 8;
+static const size_t sMaxRleWidth = 32768;
+// same limit per side as stb, and a bound on the decoded size as RLE data can expand ~700x over the file
+static const size_t sMaxDimension = size_t(1) << 24;
+static const size_t sMaxTexels = size_t(1) << 28;
+
+
+// next '\n' terminated line, false if there is none
+static bool ReadHeaderLine(const BytesArray& file, size_t& offset, String& line) {
+    const uint8_t* begin = file.data() + offset;
+    const uint8_t* lineEnd = scast<const uint8_t*>(memchr(begin, '\n', file.size() - offset));
+    if (!lineEnd) {
+        return false;
+    }
+
+    line.assign(rcast<const char*>(begin), lineEnd - begin);
+    offset += (lineEnd - begin) + 1;
+    return true;
+}
+
+// Checks one new style RLE scanline without decoding it, returns the offset of the next one or kInvalidValue
+static size_t SkipRleScanline(const BytesArray& file, size_t offset, const size_t width) {
+    const uint8_t* data = file.data();
+    const size_t size = file.size();
+
+    if (size - offset < 4 || data[offset] != 2 || data[offset + 1] != 2 || (data[offset + 2] & 0x80) ||
+        ((scast<size_t>(data[offset + 2]) << 8) | data[offset + 3]) != width) {
+        return kInvalidValue;
+    }
+    offset += 4;
+
+    for (size_t c = 0; c < 4; ++c) {
+        for (size_t x = 0; x < width;) {
+            if (offset >= size) {
+                return kInvalidValue;
+            }
+
+            size_t count = data[offset++];
+            size_t dataBytes = count;
+            if (count > 128) {
+                count -= 128;
+                dataBytes = 1;
+            }
+
+            if (count > width - x || dataBytes > size - offset) {
+                return kInvalidValue;
+            }
+
+            offset += dataBytes;
+            x += count;
+        }
+    }
+
+    return offset;
+}
+
+// one scanline checked by SkipRleScanline into its R, G, B and E planes
+static void DecodeRleScanline(const uint8_t* src, const size_t width, uint8_t* planes) {
+    src += 4;
+    for (size_t c = 0; c < 4; ++c) {
+        uint8_t* plane = planes + c * width;
+        for (size_t x = 0; x < width;) {
+            size_t count = *src++;
+            if (count > 128) {
+                count -= 128;
+                memset(plane + x, *src++, count);
+            } else {
+                memcpy(plane + x, src, count);
+                src += count;
+            }
+            x += count;
+        }
+    }
+}
+
+static void DecodeFlatScanline(const uint8_t* src, const size_t width, uint8_t* planes) {
+    for (size_t x = 0; x < width; ++x, src += 4) {
+        planes[x] = src[0];
+        planes[x + width] = src[1];
+        planes[x + width * 2] = src[2];
+        planes[x + width * 3] = src[3];
+    }
+}
+
+
+#if MM_SIMD_X64
+static __m128i LoadBytes4(const uint8_t* src) {
+    int32_t bytes;
+    memcpy(&bytes, src, sizeof(bytes));
+
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+}
+
+// 2^exponent, exponent in the normal range
+static __m128 Exp2i4(const __m128i exponent) {
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127)), 23));
+}
+#endif
+
+// value = mantissa * 2^(e - 136), 0 if e is 0, exactly what stbi_loadf does
+static void ExpandRGBE(const uint8_t* planes, const size_t width, vec3* dst) {
+    const uint8_t* r = planes;
+    const uint8_t* g = planes + width;
+    const uint8_t* b = planes + width * 2;
+    const uint8_t* e = planes + width * 3;
+
+    size_t x = 0;
+
+#if MM_SIMD_X64
+    for (; x + 4 <= width; x += 4) {
+        const __m128i e4 = LoadBytes4(e + x);
+
+        // The scale is exact but spans 2^-135..2^119, more than a float exponent holds, it's applied
+        // as two halves instead. Both products are exact, the result is bit-identical to the scalar path.
+        const __m128i exponent = _mm_sub_epi32(e4, _mm_set1_epi32(136));
+        const __m128i exponentLo = _mm_srai_epi32(exponent, 1);
+        const __m128 scaleLo = Exp2i4(exponentLo);
+        const __m128 scaleHi = Exp2i4(_mm_sub_epi32(exponent, exponentLo));
+        const __m128 isZero = _mm_castsi128_ps(_mm_cmpeq_epi32(e4, _mm_setzero_si128()));
+
+        const __m128 r4 = _mm_andnot_ps(isZero, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(LoadBytes4(r + x)), scaleLo), scaleHi));
+        const __m128 g4 = _mm_andnot_ps(isZero, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(LoadBytes4(g + x)), scaleLo), scaleHi));
+        const __m128 b4 = _mm_andnot_ps(isZero, _mm_mul_ps(_mm_mul_ps(_mm_cvtepi32_ps(LoadBytes4(b + x)), scaleLo), scaleHi));
+
+        // r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+        const __m128 rgLo = _mm_unpacklo_ps(r4, g4);
+        const __m128 rgHi = _mm_unpackhi_ps(r4, g4);
+        const __m128 out0 = _mm_shuffle_ps(rgLo, _mm_shuffle_ps(b4, rgLo, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+        const __m128 out1 = _mm_shuffle_ps(_mm_shuffle_ps(rgLo, b4, _MM_SHUFFLE(1, 1, 3, 3)), rgHi, _MM_SHUFFLE(1, 0, 2, 0));
+        const __m128 out2 = _mm_shuffle_ps(_mm_shuffle_ps(b4, rgHi, _MM_SHUFFLE(3, 2, 2, 2)), _mm_shuffle_ps(rgHi, b4, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+
+        float* out = rcast<float*>(dst + x);
+        _mm_storeu_ps(out, out0);
+        _mm_storeu_ps(out + 4, out1);
+        _mm_storeu_ps(out + 8, out2);
+    }
+#endif
+
+    for (; x < width; ++x) {
+        if (e[x]) {
+            const float scale = scast<float>(std::ldexp(1.0f, scast<int>(e[x]) - 136));
+            dst[x] = vec3(r[x] * scale, g[x] * scale, b[x] * scale);
+        } else {
+            dst[x] = vec3(0.0f);
+        }
+    }
+}
+
+
+#if MM_SIMD_X64
+// low bytes of the 4 lanes
+static void StoreBytes4(const __m128i value, uint8_t* dst) {
+    const __m128i bytes = _mm_and_si128(value, _mm_set1_epi32(0xFF));
+    const int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(bytes, bytes), bytes));
+    memcpy(dst, &packed, sizeof(packed));
+}
+#endif
+
+// float -> RGBE into R, G, B and E planes, exactly what stbi_write_hdr does:
+// mantissa = value * 256 / 2^e with maxComponent = m * 2^e, m in [0.5, 1), truncated
+static void PackRGBE(const vec3* src, const ptrdiff_t srcStep, const size_t width, uint8_t* planes) {
+    uint8_t* r = planes;
+    uint8_t* g = planes + width;
+    uint8_t* b = planes + width * 2;
+    uint8_t* e = planes + width * 3;
+
+    size_t x = 0;
+
+#if MM_SIMD_X64
+    for (; x + 4 <= width; x += 4, src += srcStep * 4) {
+        const vec3& t0 = src[0];
+        const vec3& t1 = src[srcStep];
+        const vec3& t2 = src[srcStep * 2];
+        const vec3& t3 = src[srcStep * 3];
+        const __m128 r4 = _mm_setr_ps(t0.x, t1.x, t2.x, t3.x);
+        const __m128 g4 = _mm_setr_ps(t0.y, t1.y, t2.y, t3.y);
+        const __m128 b4 = _mm_setr_ps(t0.z, t1.z, t2.z, t3.z);
+
+        const __m128 maxComponent = _mm_max_ps(r4, _mm_max_ps(g4, b4));
+        const __m128i isZero = _mm_castps_si128(_mm_cmplt_ps(maxComponent, _mm_set1_ps(1e-32f)));
+
+        // maxComponent is normal here, its frexp exponent is the biased float exponent - 126 and
+        // 256 / 2^e is a power of two that can be put together right away, no division
+        const __m128i biasedExponent = _mm_srli_epi32(_mm_slli_epi32(_mm_castps_si128(maxComponent), 1), 24);
+        const __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 8 + 126), biasedExponent), 23));
+
+        StoreBytes4(_mm_andnot_si128(isZero, _mm_cvttps_epi32(_mm_mul_ps(r4, scale))), r + x);
+        StoreBytes4(_mm_andnot_si128(isZero, _mm_cvttps_epi32(_mm_mul_ps(g4, scale))), g + x);
+        StoreBytes4(_mm_andnot_si128(isZero, _mm_cvttps_epi32(_mm_mul_ps(b4, scale))), b + x);
+        StoreBytes4(_mm_andnot_si128(isZero, _mm_add_epi32(biasedExponent, _mm_set1_epi32(128 - 126))), e + x);
+    }
+#endif
+
+    for (; x < width; ++x, src += srcStep) {
+        const float maxComponent = Maximum(src->x, Maximum(src->y, src->z));
+        if (maxComponent < 1e-32f) {
+            r[x] = g[x] = b[x] = e[x] = 0;
+        } else {
+            int exponent = 0;
+            const float normalize = std::frexp(maxComponent, &exponent) * 256.0f / maxComponent;
+            r[x] = scast<uint8_t>(scast<int32_t>(src->x * normalize));
+            g[x] = scast<uint8_t>(scast<int32_t>(src->y * normalize));
+            b[x] = scast<uint8_t>(scast<int32_t>(src->z * normalize));
+            e[x] = scast<uint8_t>(exponent + 128);
+        }
+    }
+}
+
+// The same encoding stbi_write_hdr does: literal dumps of up to 128 bytes, runs of 3+ equal bytes of up to 127
+static uint8_t* EncodeRlePlane(const uint8_t* plane, const size_t width, uint8_t* dst) {
+    size_t x = 0;
+    while (x < width) {
+        // next run
+        size_t r = x;
+        while (r + 2 < width && !(plane[r] == plane[r + 1] && plane[r] == plane[r + 2])) {
+            ++r;
+        }
+        const bool isRun = r + 2 < width;
+        if (!isRun) {
+            r = width;
+        }
+
+        // dump up to it
+        while (x < r) {
+            const size_t length = Minimum<size_t>(r - x, 128);
+            *dst++ = scast<uint8_t>(length);
+            memcpy(dst, plane + x, length);
+            dst += length;
+            x += length;
+        }
+
+        if (isRun) {
+            while (r < width && plane[r] == plane[x]) {
+                ++r;
+            }
+            while (x < r) {
+                const size_t length = Minimum<size_t>(r - x, 127);
+                *dst++ = scast<uint8_t>(128 + length);
+                *dst++ = plane[x];
+                x += length;
+            }
+        }
+    }
+
+    return dst;
+}
+
+// one scanline of planes, returns the end of the written bytes
+static uint8_t* EncodeScanline(const uint8_t* planes, const size_t width, uint8_t* dst) {
+    if (width < sMinRleWidth || width >= sMaxRleWidth) {
+        for (size_t x = 0; x < width; ++x) {
+            *dst++ = planes[x];
+            *dst++ = planes[x + width];
+            *dst++ = planes[x + width * 2];
+            *dst++ = planes[x + width * 3];
+        }
+        return dst;
+    }
+
+    *dst++ = 2;
+    *dst++ = 2;
+    *dst++ = scast<uint8_t>(width >> 8);
+    *dst++ = scast<uint8_t>(width & 0xFF);
+    for (size_t c = 0; c < 4; ++c) {
+        dst = EncodeRlePlane(planes + c * width, width, dst);
+    }
+    return dst;
+}
+
+// worst case of EncodeScanline, every dump but the 128 long ones is followed by a run of 3 or more
+static size_t GetMaxScanlineBytes(const size_t width) {
+    return 4 + 4 * (width + width / 3 + 2);
+}
+
+bool LoadRadianceHDR(const fs::path& path, size_t& width, size_t& height, Array<vec3>& pixels, JobProgress* progress) {
+    TRACE_ZONE("LoadRadianceHDR");
+
+    BytesArray file;
+    {
+        TRACE_ZONE("Read file");
+
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        if (!stream) {
+            return false;
+        }
+
+        const std::streamoff fileSize = stream.tellg();
+        if (fileSize <= 0) {
+            return false;
+        }
+
+        file.resize(scast<size_t>(fileSize));
+        stream.seekg(0);
+        if (!stream.read(rcast<char*>(file.data()), fileSize)) {
+            return false;
+        }
+
+        TRACE_BYTES_READ(file.size());
+    }
+
+    // header
+    size_t offset = 0;
+    String line;
+    if (!ReadHeaderLine(file, offset, line) || (line != "#?RADIANCE" && line != "#?RGBE")) {
+        return false;
+    }
+
+    bool isRGBE = false;
+    while (ReadHeaderLine(file, offset, line) && !line.empty()) {
+        isRGBE = isRGBE || line == "FORMAT=32-bit_rle_rgbe";
+    }
+
+    int imgWidth = 0, imgHeight = 0;
+    if (!isRGBE || !ReadHeaderLine(file, offset, line) || sscanf(line.c_str(), "-Y %d +X %d", &imgHeight, &imgWidth) != 2 ||
+        imgWidth <= 0 || imgHeight <= 0) {
+        return false;
+    }
+
+    const size_t w = scast<size_t>(imgWidth);
+    const size_t h = scast<size_t>(imgHeight);
+    if (w > sMaxDimension || h > sMaxDimension) {
+        return false;
+    }
+
+    // where every scanline starts, a flat image is simply w * 4 bytes per scanline
+    bool isFlat = w < sMinRleWidth || w >= sMaxRleWidth;
+    // the first scanline tells, new style RLE can't start with 2, 2 and a valid pixel
+    if (!isFlat) {
+        const uint8_t* first = file.data() + offset;
+        isFlat = file.size() - offset >= 4 && (first[0] != 2 || first[1] != 2 || (first[2] & 0x80));
+    }
+
+    Array<size_t> scanlineOffsets;
+    if (isFlat) {
+        if ((file.size() - offset) / 4 / w < h) {
+            return false;
+        }
+    } else {
+        TRACE_ZONE("Index scanlines");
+
+        // every RLE scanline takes at least its 4 byte header, a corrupt height can't size the index
+        if ((file.size() - offset) / 4 < h) {
+            return false;
+        }
+
+        scanlineOffsets.resize(h);
+        for (size_t y = 0; y < h; ++y) {
+            scanlineOffsets[y] = offset;
+            offset = SkipRleScanline(file, offset, w);
+            if (offset == kInvalidValue) {
+                return false;
+            }
+        }
+    }
+
+    if ((progress && progress->IsCancelled()) || w * h > sMaxTexels) {
+        return false;
+    }
+
+    Array<vec3> decoded(w * h);
+    {
+        TRACE_ZONE("Decode scanlines");
+        TRACE_PIXELS(w * h);
+        TRACE_BYTES_WRITTEN(w * h * sizeof(vec3));
+
+        ThreadPool::Get().ParallelFor(0, h, sBandRows, [&](const size_t rowBegin, const size_t rowEnd) {
+            if (progress && progress->IsCancelled()) {
+                return;
+            }
+
+            BytesArray planes(w * 4);
+            for (size_t y = rowBegin; y < rowEnd; ++y) {
+                if (isFlat) {
+                    DecodeFlatScanline(file.data() + offset + y * w * 4, w, planes.data());
+                } else {
+                    DecodeRleScanline(file.data() + scanlineOffsets[y], w, planes.data());
+                }
+                ExpandRGBE(planes.data(), w, decoded.data() + y * w);
+            }
+
+            if (progress) {
+                progress->AddItems(rowEnd - rowBegin);
+            }
+        });
+    }
+
+    if (progress && progress->IsCancelled()) {
+        return false;
+    }
+
+    width = w;
+    height = h;
+    pixels.swap(decoded);
+
+    return true;
+}
+
+bool SaveRadianceHDR(const fs::path& path, const ImageView& img, JobProgress* progress) {
+    if (!img.data || !img.width || !img.height) {
+        return false;
+    }
+
+    TRACE_ZONE("SaveRadianceHDR");
+
+    const size_t w = img.width;
+    const size_t h = img.height;
+
+    const size_t numBands = (h + sBandRows - 1) / sBandRows;
+    Array<BytesArray> bands(numBands);
+    {
+        TRACE_ZONE("Encode scanlines");
+        TRACE_PIXELS(w * h);
+        TRACE_BYTES_READ(w * h * sizeof(vec3));
+
+        ThreadPool::Get().ParallelFor(0, numBands, 1, [&](const size_t bandBegin, const size_t bandEnd) {
+            BytesArray planes(w * 4);
+            BytesArray encoded(GetMaxScanlineBytes(w) * sBandRows);
+
+            for (size_t band = bandBegin; band < bandEnd; ++band) {
+                if (progress && progress->IsCancelled()) {
+                    return;
+                }
+
+                const size_t rowBegin = band * sBandRows;
+                const size_t rowEnd = Minimum(rowBegin + sBandRows, h);
+
+                uint8_t* dst = encoded.data();
+                for (size_t y = rowBegin; y < rowEnd; ++y) {
+                    PackRGBE(img.RowBegin(y), img.TexelStep(), w, planes.data());
+                    dst = EncodeScanline(planes.data(), w, dst);
+                }
+                bands[band].assign(encoded.data(), dst);
+
+                if (progress) {
+                    progress->AddItems(rowEnd - rowBegin);
+                }
+            }
+        });
+    }
+
+    if (progress && progress->IsCancelled()) {
+        return false;
+    }
+
+    TRACE_ZONE("Write file");
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+
+    char header[128];
+    const int headerLength = snprintf(header, sizeof(header), "#?RADIANCE\n# Written by iCube\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n", scast<int>(h), scast<int>(w));
+    file.write(header, headerLength);
+
+    for (const BytesArray& band : bands) {
+        file.write(rcast<const char*>(band.data()), band.size());
+        TRACE_BYTES_WRITTEN(band.size());
+    }
+
+    return file.good();
+}
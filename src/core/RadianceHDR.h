@@ -0,0 +1,20 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+#include "ImageView.h"
+#include "JobProgress.h"
+
+
+// Radiance RGBE (.hdr) files in the layout stb and most tools write: "-Y h +X w", new style RLE or flat scanlines.
+// The scanlines done are added to `progress` (AddItems), BeginItems is up to the caller so several files can share a job.
+//
+// The whole file is read in one go, a quick pre-scan walks the run lengths to index where every scanline starts,
+// then the scanlines are decoded in parallel bands straight into `pixels`. RGBE -> float is SSE2 on x64 and
+// bit-identical to stbi_loadf. Returns false for anything else (old style RLE, other orientations, corrupt data)
+// or if the job got cancelled, `width`, `height` and `pixels` are only touched on success.
+bool    LoadRadianceHDR(const fs::path& path, size_t& width, size_t& height, Array<vec3>& pixels, JobProgress* progress = nullptr);
+
+// Bands of scanlines are converted and RLE encoded on the thread pool into their own buffers, which are then
+// written out in order. The pixel data is byte for byte what stbi_write_hdr writes, only the header differs.
+// Returns false if the file can't be written or the job got cancelled.
+bool    SaveRadianceHDR(const fs::path& path, const ImageView& img, JobProgress* progress = nullptr);
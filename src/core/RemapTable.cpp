@@ -0,0 +1,305 @@
+#include "RemapTable.h"
+#include "AtomicFile.h"
+#include "LdrPixels.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+#include <fstream>
+
+// "ICRT" + version, bumped whenever the layout or the mapping math changes
+static const uint32_t sRemapFileMagic = 0x54524349;
+static const uint32_t sRemapFileVersion = 2;
+
+static const size_t sRemapTileRows = 16;
+static const size_t sDefaultCacheBudget = size_t(1) << 30;
+
+static const char* sProjectionNames[] = {
+    "latlong", "faces"
+};
+
+
+bool RemapKey::operator ==(const RemapKey& other) const {
+    return srcProjection == other.srcProjection &&
+           dstProjection == other.dstProjection &&
+           srcWidth == other.srcWidth &&
+           srcHeight == other.srcHeight &&
+           dstWidth == other.dstWidth &&
+           dstHeight == other.dstHeight &&
+           precision == other.precision;
+}
+
+
+RemapTable::RemapTable()
+    : mKey{}
+    , mNumDstPlanes(0)
+{
+}
+RemapTable::~RemapTable() {
+}
+
+void RemapTable::Allocate(const RemapKey& key, const size_t numDstPlanes) {
+    mKey = key;
+    mNumDstPlanes = numDstPlanes;
+    mTaps.resize(this->GetNumDstTexels());
+}
+
+const RemapKey& RemapTable::GetKey() const {
+    return mKey;
+}
+
+size_t RemapTable::GetNumDstTexels() const {
+    return mKey.dstWidth * mKey.dstHeight * mNumDstPlanes;
+}
+
+size_t RemapTable::GetSizeInBytes() const {
+    return mTaps.size() * sizeof(RemapTap);
+}
+
+RemapTap* RemapTable::GetRowTaps(const size_t row) {
+    return mTaps.data() + row * mKey.dstWidth;
+}
+
+void RemapTable::Apply(const vec3* src, const ImageView* dstPlanes, JobProgress* progress) const {
+    TRACE_ZONE("RemapTable::Apply");
+    TRACE_PIXELS(this->GetNumDstTexels());
+    TRACE_BYTES_READ(this->GetSizeInBytes());
+    TRACE_BYTES_WRITTEN(this->GetNumDstTexels() * sizeof(vec3));
+
+    this->ForEachDstRow(progress, [&](const size_t plane, const size_t y, const RemapTap* taps) {
+        const ImageView& dstView = dstPlanes[plane];
+        vec3* dst = dstView.RowBegin(y);
+        const ptrdiff_t dstStep = dstView.TexelStep();
+
+        for (size_t x = 0; x < mKey.dstWidth; ++x, dst += dstStep) {
+            *dst = ApplyBilinearTap(src, taps[x]);
+        }
+    });
+}
+
+void RemapTable::Apply(const Rgb8* src, const ImageView8* dstPlanes, JobProgress* progress) const {
+    TRACE_ZONE("RemapTable::Apply LDR");
+    TRACE_PIXELS(this->GetNumDstTexels());
+    TRACE_BYTES_READ(this->GetSizeInBytes());
+    TRACE_BYTES_WRITTEN(this->GetNumDstTexels() * sizeof(Rgb8));
+
+    this->ForEachDstRow(progress, [&](const size_t plane, const size_t y, const RemapTap* taps) {
+        const ImageView8& dstView = dstPlanes[plane];
+        RemapLdrTexels(src, taps, mKey.dstWidth, dstView.RowBegin(y), dstView.TexelStep());
+    });
+}
+
+void RemapTable::Apply(const Rgb16* src, const ImageView8* dstPlanes, JobProgress* progress) const {
+    TRACE_ZONE("RemapTable::Apply LDR");
+    TRACE_PIXELS(this->GetNumDstTexels());
+    TRACE_BYTES_READ(this->GetSizeInBytes());
+    TRACE_BYTES_WRITTEN(this->GetNumDstTexels() * sizeof(Rgb8));
+
+    this->ForEachDstRow(progress, [&](const size_t plane, const size_t y, const RemapTap* taps) {
+        const ImageView8& dstView = dstPlanes[plane];
+        RemapLdrTexels(src, taps, mKey.dstWidth, dstView.RowBegin(y), dstView.TexelStep());
+    });
+}
+
+template <typename RowFunc>
+void RemapTable::ForEachDstRow(JobProgress* progress, const RowFunc& rowFunc) const {
+    const size_t width = mKey.dstWidth;
+    const size_t height = mKey.dstHeight;
+
+    if (progress) {
+        progress->BeginItems(mNumDstPlanes * height);
+    }
+
+    ThreadPool::Get().ParallelFor(0, mNumDstPlanes * height, sRemapTileRows, [&](const size_t rowBegin, const size_t rowEnd) {
+        if (progress && progress->IsCancelled()) {
+            return;
+        }
+
+        for (size_t row = rowBegin; row < rowEnd; ++row) {
+            rowFunc(row / height, row % height, mTaps.data() + row * width);
+        }
+
+        if (progress) {
+            progress->AddItems(rowEnd - rowBegin);
+        }
+    });
+}
+
+bool RemapTable::SaveToFile(const fs::path& path) const {
+    TRACE_ZONE("RemapTable::SaveToFile");
+    TRACE_BYTES_WRITTEN(this->GetSizeInBytes());
+
+    const uint32_t header[] = {
+        sRemapFileMagic,
+        sRemapFileVersion,
+        scast<uint32_t>(mKey.srcProjection),
+        scast<uint32_t>(mKey.dstProjection),
+        scast<uint32_t>(mKey.srcWidth),
+        scast<uint32_t>(mKey.srcHeight),
+        scast<uint32_t>(mKey.dstWidth),
+        scast<uint32_t>(mKey.dstHeight),
+        scast<uint32_t>(mKey.precision),
+        scast<uint32_t>(mNumDstPlanes)
+    };
+
+    // another instance may be loading the same table meanwhile
+    return WriteFileAtomic(path, [&](std::ofstream& file) {
+        file.write(rcast<const char*>(header), sizeof(header));
+        file.write(rcast<const char*>(mTaps.data()), mTaps.size() * sizeof(RemapTap));
+        return file.good();
+    });
+}
+
+bool RemapTable::LoadFromFile(const fs::path& path, const RemapKey& expectedKey, const size_t expectedNumDstPlanes) {
+    TRACE_ZONE("RemapTable::LoadFromFile");
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    uint32_t header[10] = {};
+    file.read(rcast<char*>(header), sizeof(header));
+    if (!file || header[0] != sRemapFileMagic || header[1] != sRemapFileVersion) {
+        return false;
+    }
+
+    RemapKey key;
+    key.srcProjection = scast<EnvProjection>(header[2]);
+    key.dstProjection = scast<EnvProjection>(header[3]);
+    key.srcWidth = header[4];
+    key.srcHeight = header[5];
+    key.dstWidth = header[6];
+    key.dstHeight = header[7];
+    key.precision = scast<MathPrecision>(header[8]);
+    if (!(key == expectedKey) || header[9] != expectedNumDstPlanes) {
+        return false;
+    }
+
+    this->Allocate(key, expectedNumDstPlanes);
+    file.read(rcast<char*>(mTaps.data()), mTaps.size() * sizeof(RemapTap));
+    TRACE_BYTES_READ(mTaps.size() * sizeof(RemapTap));
+    if (!file.good()) {
+        return false;
+    }
+
+    // the kernels index the source without checks, a damaged file must not get that far.
+    // The taps of a CubeFaces source address the whole cross, 3x4 faces.
+    const size_t numSrcTexels = key.srcWidth * key.srcHeight * ((key.srcProjection == EnvProjection::CubeFaces) ? 12 : 1);
+    for (const RemapTap& tap : mTaps) {
+        if (tap.index[0] >= numSrcTexels || tap.index[1] >= numSrcTexels || tap.index[2] >= numSrcTexels || tap.index[3] >= numSrcTexels) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+RemapTableCache& RemapTableCache::Get() {
+    static RemapTableCache sSharedCache;
+    return sSharedCache;
+}
+
+RemapTableCache::RemapTableCache()
+    : mTotalBytes(0)
+    , mBudget(sDefaultCacheBudget)
+{
+}
+
+void RemapTableCache::SetBudget(const size_t maxBytes) {
+    std::lock_guard<std::mutex> guard(mLock);
+    mBudget = maxBytes;
+
+    while (mTotalBytes > mBudget && !mTables.empty()) {
+        mTotalBytes -= mTables.back()->GetSizeInBytes();
+        mTables.pop_back();
+    }
+}
+
+size_t RemapTableCache::GetBudget() const {
+    std::lock_guard<std::mutex> guard(mLock);
+    return mBudget;
+}
+
+void RemapTableCache::SetPersistentFolder(const fs::path& folder) {
+    std::lock_guard<std::mutex> guard(mLock);
+    mPersistentFolder = folder;
+}
+
+void RemapTableCache::Clear() {
+    std::lock_guard<std::mutex> guard(mLock);
+    mTables.clear();
+    mTotalBytes = 0;
+}
+
+bool RemapTableCache::CanCache(const size_t tableBytes) const {
+    std::lock_guard<std::mutex> guard(mLock);
+    return tableBytes <= mBudget;
+}
+
+RemapTableCache::TablePtr RemapTableCache::FindOrBuild(const RemapKey& key, const size_t numDstPlanes, const BuildFunc& builder) {
+    fs::path tablePath;
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        for (auto it = mTables.begin(); it != mTables.end(); ++it) {
+            if ((*it)->GetKey() == key) {
+                TablePtr table = *it;
+                mTables.splice(mTables.begin(), mTables, it);
+                return table;
+            }
+        }
+
+        if (!mPersistentFolder.empty()) {
+            tablePath = this->GetTablePath(key);
+        }
+    }
+
+    // miss - building (or reading) happens outside the lock, other sizes stay available meanwhile
+    std::shared_ptr<RemapTable> table = std::make_shared<RemapTable>();
+
+    std::error_code ec;
+    if (tablePath.empty() || !fs::exists(tablePath, ec) || !table->LoadFromFile(tablePath, key, numDstPlanes)) {
+        TRACE_ZONE("RemapTable build");
+
+        table->Allocate(key, numDstPlanes);
+        if (!builder(*table)) {
+            return nullptr;
+        }
+        TRACE_PIXELS(table->GetNumDstTexels());
+
+        if (!tablePath.empty()) {
+            fs::create_directories(tablePath.parent_path(), ec);
+            table->SaveToFile(tablePath);
+        }
+    }
+
+    this->Insert(table);
+    return table;
+}
+
+fs::path RemapTableCache::GetTablePath(const RemapKey& key) const {
+    const String name = String("remap_") +
+                        sProjectionNames[scast<size_t>(key.srcProjection)] + "_" + std::to_string(key.srcWidth) + "x" + std::to_string(key.srcHeight) + "_to_" +
+                        sProjectionNames[scast<size_t>(key.dstProjection)] + "_" + std::to_string(key.dstWidth) + "x" + std::to_string(key.dstHeight) +
+                        (key.precision == MathPrecision::Exact ? "_exact" : "_fast") + ".bin";
+    return mPersistentFolder / name;
+}
+
+void RemapTableCache::Insert(const TablePtr& table) {
+    std::lock_guard<std::mutex> guard(mLock);
+
+    // someone else might have built the same table meanwhile
+    for (const TablePtr& cached : mTables) {
+        if (cached->GetKey() == table->GetKey()) {
+            return;
+        }
+    }
+
+    mTables.push_front(table);
+    mTotalBytes += table->GetSizeInBytes();
+
+    while (mTotalBytes > mBudget && mTables.size() > 1) {
+        mTotalBytes -= mTables.back()->GetSizeInBytes();
+        mTables.pop_back();
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include "mycommon.h"
+#include "mymath.h"
+#include "ImageView.h"
+#include "JobProgress.h"
+
+#include <functional>
+#include <list>
+#include <mutex>
+
+
+enum class EnvProjection : uint32_t {
+    LatLong = 0,
+    CubeFaces = 1
+};
+
+// Bilinear footprint of one output texel: four source texel indices and their weights
+struct RemapTap {
+    uint32_t    index[4];
+    float       weight[4];
+};
+
+// Bilinear, clamped - the one and only place the weights are computed, so a
+// remapped image is bit-identical to sampling the source texel by texel.
+// `texelIndex(x, y)` maps the corners to the source buffer.
+template <typename IndexFunc>
+inline void MakeBilinearTap(const size_t width, const size_t height, const float u, const float v, RemapTap& tap, IndexFunc texelIndex) {
+    float mu = Clamp(u, 0.0f, 1.0f);
+    float mv = Clamp(v, 0.0f, 1.0f);
+
+    const float fu = mu * scast<float>(width - 1);
+    const float fv = mv * scast<float>(height - 1);
+
+    const size_t u00 = scast<size_t>(fu);
+    const size_t u01 = Minimum(u00 + 1, width - 1);
+    const size_t v00 = scast<size_t>(fv);
+    const size_t v10 = Minimum(v00 + 1, height - 1);
+
+    const float ku = fu - u00;
+    const float kv = fv - v00;
+    const float kuv = ku * kv;
+
+    tap.index[0] = scast<uint32_t>(texelIndex(u00, v00));
+    tap.index[1] = scast<uint32_t>(texelIndex(u01, v00));
+    tap.index[2] = scast<uint32_t>(texelIndex(u00, v10));
+    tap.index[3] = scast<uint32_t>(texelIndex(u01, v10));
+
+    tap.weight[0] = 1 - ku - kv + kuv;
+    tap.weight[1] = ku - kuv;
+    tap.weight[2] = kv - kuv;
+    tap.weight[3] = kuv;
+}
+
+inline void MakeBilinearTap(const size_t width, const size_t height, const float u, const float v, RemapTap& tap) {
+    MakeBilinearTap(width, height, u, v, tap, [width](const size_t x, const size_t y) { return x + y * width; });
+}
+
+inline void MakeBilinearTap(const ImageView& view, const float u, const float v, RemapTap& tap) {
+    MakeBilinearTap(view.width, view.height, u, v, tap, [&view](const size_t x, const size_t y) { return view.TexelIndex(x, y); });
+}
+
+inline vec3 ApplyBilinearTap(const vec3* src, const RemapTap& tap) {
+    return src[tap.index[0]] * tap.weight[0] +
+           src[tap.index[1]] * tap.weight[1] +
+           src[tap.index[2]] * tap.weight[2] +
+           src[tap.index[3]] * tap.weight[3];
+}
+
+
+struct RemapKey {
+    EnvProjection   srcProjection;
+    EnvProjection   dstProjection;
+    size_t          srcWidth;       // of a single plane (a face for CubeFaces)
+    size_t          srcHeight;
+    size_t          dstWidth;
+    size_t          dstHeight;
+    MathPrecision   precision;
+
+    bool operator ==(const RemapKey& other) const;
+};
+
+// Precomputed direction -> source texel mapping between two projections.
+// The taps index a single source buffer (the LatLong, or the cross holding the cube faces),
+// the output is made of planes (1 for LatLong, 6 face views for CubeFaces).
+class RemapTable {
+public:
+    RemapTable();
+    ~RemapTable();
+
+    void            Allocate(const RemapKey& key, const size_t numDstPlanes);
+
+    const RemapKey& GetKey() const;
+    size_t          GetNumDstTexels() const;
+    size_t          GetSizeInBytes() const;
+
+    // row = dstPlane * dstHeight + y
+    RemapTap*       GetRowTaps(const size_t row);
+
+    // Pure gather pass, parallel over the output rows. Stops early if the job gets cancelled.
+    void            Apply(const vec3* src, const ImageView* dstPlanes, JobProgress* progress = nullptr) const;
+    // LDR texels, filtered in linear light and encoded back to 8 bit sRGB (LdrPixels.h)
+    void            Apply(const Rgb8* src, const ImageView8* dstPlanes, JobProgress* progress = nullptr) const;
+    void            Apply(const Rgb16* src, const ImageView8* dstPlanes, JobProgress* progress = nullptr) const;
+
+    bool            SaveToFile(const fs::path& path) const;
+    // false for anything but the expected table, taps that would read outside the source included
+    bool            LoadFromFile(const fs::path& path, const RemapKey& expectedKey, const size_t expectedNumDstPlanes);
+
+private:
+    // parallel over the output rows, `rowFunc(dstPlane, y, taps)`
+    template <typename RowFunc>
+    void            ForEachDstRow(JobProgress* progress, const RowFunc& rowFunc) const;
+
+private:
+    RemapKey        mKey;
+    size_t          mNumDstPlanes;
+    Array<RemapTap> mTaps;
+};
+
+
+// Process-wide LRU cache of remap tables, bounded by their total size.
+// Optionally backed by a folder on disk so the tables survive between runs.
+class RemapTableCache {
+public:
+    using TablePtr = std::shared_ptr<const RemapTable>;
+    // returns false if the build was abandoned (cancelled), such a table is never cached
+    using BuildFunc = std::function<bool(RemapTable& table)>;
+
+    static RemapTableCache& Get();
+
+    RemapTableCache();
+
+    void        SetBudget(const size_t maxBytes);
+    size_t      GetBudget() const;
+    void        SetPersistentFolder(const fs::path& folder);
+    void        Clear();
+
+    // Tables that would not fit the budget are never built, the caller falls back to direct conversion then
+    bool        CanCache(const size_t tableBytes) const;
+    // nullptr if the builder gave up
+    TablePtr    FindOrBuild(const RemapKey& key, const size_t numDstPlanes, const BuildFunc& builder);
+
+private:
+    fs::path    GetTablePath(const RemapKey& key) const;
+    void        Insert(const TablePtr& table);
+
+private:
+    mutable std::mutex  mLock;
+    std::list<TablePtr> mTables;        // most recently used first
+    size_t              mTotalBytes;
+    size_t              mBudget;
+    fs::path            mPersistentFolder;
+};
@@ -0,0 +1,177 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+
+
+ThreadPool::Job::Job(const size_t numQueues)
+    : func(nullptr)
+    , queues(numQueues)
+    , numPending(0)
+    , cancelled(false)
+{
+}
+
+bool ThreadPool::Job::PopTile(const size_t slot, Tile& tile) {
+    // own tiles first, front to back to keep the access pattern linear
+    {
+        TileQueue& own = queues[slot];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tiles.empty()) {
+            tile = own.tiles.front();
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+
+    // steal from the back of the others
+    const size_t numQueues = queues.size();
+    for (size_t i = 1; i < numQueues; ++i) {
+        TileQueue& victim = queues[(slot + i) % numQueues];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tiles.empty()) {
+            tile = victim.tiles.back();
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::Job::Run(const size_t slot) {
+    Tile tile;
+    while (this->PopTile(slot, tile)) {
+        // a tile must never unwind past here, a worker would terminate and the caller would
+        // return while the workers still run its func
+        if (!cancelled.load()) {
+            TRACE_ZONE("ParallelFor tile");
+            try {
+                (*func)(tile.begin, tile.end);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(errorLock);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                cancelled = true;
+            }
+        }
+
+        if (numPending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> guard(doneLock);
+            doneCondition.notify_all();
+        }
+    }
+}
+
+
+ThreadPool& ThreadPool::Get() {
+    static ThreadPool sSharedPool(Maximum(scast<size_t>(std::thread::hardware_concurrency()), size_t(1)) - 1);
+    return sSharedPool;
+}
+
+ThreadPool::ThreadPool(const size_t numWorkers)
+    : mStop(false)
+{
+    mWorkers.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; ++i) {
+        mWorkers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mStop = true;
+    }
+    mCondition.notify_all();
+
+    for (std::thread& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::GetConcurrency() const {
+    return mWorkers.size() + 1;
+}
+
+void ThreadPool::ParallelFor(const size_t begin, const size_t end, const size_t grain, const RangeFunc& func) {
+    if (begin >= end) {
+        return;
+    }
+
+    const size_t tileSize = Maximum(grain, size_t(1));
+    const size_t numTiles = (end - begin + tileSize - 1) / tileSize;
+
+    if (mWorkers.empty() || numTiles < 2) {
+        func(begin, end);
+        return;
+    }
+
+    // the calling thread takes the last slot
+    const size_t numQueues = mWorkers.size() + 1;
+    const size_t callerSlot = mWorkers.size();
+
+    std::shared_ptr<Job> job = std::make_shared<Job>(numQueues);
+    job->func = &func;
+    job->numPending = numTiles;
+
+    // deal out contiguous blocks of tiles so that every participant starts on its own part of the image
+    for (size_t q = 0; q < numQueues; ++q) {
+        const size_t firstTile = (q * numTiles) / numQueues;
+        const size_t lastTile = ((q + 1) * numTiles) / numQueues;
+        for (size_t t = firstTile; t < lastTile; ++t) {
+            const size_t tileBegin = begin + t * tileSize;
+            job->queues[q].tiles.push_back({ tileBegin, Minimum(tileBegin + tileSize, end) });
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mJobs.push_back(job);
+    }
+    mCondition.notify_all();
+
+    job->Run(callerSlot);
+
+    // no tiles left to hand out - retire the job so the workers won't pick it up again
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        auto it = std::find(mJobs.begin(), mJobs.end(), job);
+        if (it != mJobs.end()) {
+            mJobs.erase(it);
+        }
+    }
+
+    // wait for the tiles stolen by the workers
+    {
+        std::unique_lock<std::mutex> lock(job->doneLock);
+        job->doneCondition.wait(lock, [&job]() { return job->numPending.load() == 0; });
+    }
+
+    if (job->error) {
+        std::rethrow_exception(job->error);
+    }
+}
+
+void ThreadPool::WorkerLoop(const size_t slot) {
+    TRACE_THREAD_NAME(("pool worker " + std::to_string(slot)).c_str());
+
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mCondition.wait(lock, [this]() { return mStop || !mJobs.empty(); });
+            if (mStop) {
+                break;
+            }
+            job = mJobs.front();
+        }
+
+        job->Run(slot);
+
+        {
+            std::lock_guard<std::mutex> guard(mLock);
+            if (!mJobs.empty() && mJobs.front() == job) {
+                mJobs.pop_front();
+            }
+        }
+    }
+}
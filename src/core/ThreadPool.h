@@ -0,0 +1,71 @@
+#pragma once
+#include "mycommon.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+// Shared pool of worker threads with a tile-granular, work-stealing ParallelFor.
+//
+// The range [begin, end) is cut into tiles of `grain` items, the tiles are dealt
+// out in contiguous blocks to every participant (the workers + the calling thread),
+// and whoever runs out of its own tiles steals from the back of someone else's block.
+// The calling thread always participates, so nested ParallelFor calls are safe.
+class ThreadPool {
+public:
+    using RangeFunc = std::function<void(const size_t begin, const size_t end)>;
+
+    static ThreadPool&  Get();
+
+    explicit ThreadPool(const size_t numWorkers);
+    ~ThreadPool();
+
+    // workers + the calling thread
+    size_t  GetConcurrency() const;
+
+    // if a tile throws, the tiles not started yet are skipped and the first exception
+    // is rethrown on the calling thread once every started tile has finished
+    void    ParallelFor(const size_t begin, const size_t end, const size_t grain, const RangeFunc& func);
+
+private:
+    struct Tile {
+        size_t  begin;
+        size_t  end;
+    };
+
+    struct TileQueue {
+        std::mutex          lock;
+        std::deque<Tile>    tiles;
+    };
+
+    struct Job {
+        const RangeFunc*        func;
+        Array<TileQueue>        queues;
+        std::atomic<size_t>     numPending;
+        std::mutex              doneLock;
+        std::condition_variable doneCondition;
+        // the first exception thrown by a tile, the remaining tiles are drained without running
+        std::atomic<bool>       cancelled;
+        std::mutex              errorLock;
+        std::exception_ptr      error;
+
+        explicit Job(const size_t numQueues);
+
+        bool    PopTile(const size_t slot, Tile& tile);
+        void    Run(const size_t slot);
+    };
+
+    void    WorkerLoop(const size_t slot);
+
+private:
+    Array<std::thread>                  mWorkers;
+    std::mutex                          mLock;
+    std::condition_variable             mCondition;
+    std::deque<std::shared_ptr<Job>>    mJobs;
+    bool                                mStop;
+};
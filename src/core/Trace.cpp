@@ -0,0 +1,198 @@
+#include "Trace.h"
+
+#ifdef ICUBE_ENABLE_TRACE
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+namespace Trace {
+
+    static const size_t sRingCapacity = size_t(1) << 16;   // events per thread
+
+    struct Event {
+        const char* name;
+        uint64_t    startNs;
+        uint64_t    durationNs;
+        uint64_t    bytesRead;
+        uint64_t    bytesWritten;
+        uint64_t    pixels;
+    };
+
+    // Only the owner thread writes, the lock is there for the dump (uncontended otherwise)
+    struct ThreadBuffer {
+        std::mutex      lock;
+        Array<Event>    events;
+        size_t          head = 0;       // next slot to write
+        size_t          count = 0;
+        uint32_t        tid = 0;
+        String          name;
+    };
+
+    struct Registry {
+        std::mutex                          lock;
+        Array<std::shared_ptr<ThreadBuffer>> buffers;
+        std::atomic<uint32_t>               nextTid{ 1 };
+        const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    };
+
+    static Registry& GetRegistry() {
+        static Registry sRegistry;
+        return sRegistry;
+    }
+
+    static uint64_t NowNs() {
+        return scast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - GetRegistry().epoch).count());
+    }
+
+    // the registry keeps the buffer alive after the thread is gone, so its events still make it to the dump
+    static ThreadBuffer& GetThreadBuffer() {
+        thread_local std::shared_ptr<ThreadBuffer> tBuffer;
+        if (!tBuffer) {
+            Registry& registry = GetRegistry();
+
+            tBuffer = std::make_shared<ThreadBuffer>();
+            tBuffer->events.resize(sRingCapacity);
+            tBuffer->tid = registry.nextTid.fetch_add(1);
+
+            std::lock_guard<std::mutex> guard(registry.lock);
+            registry.buffers.push_back(tBuffer);
+        }
+        return *tBuffer;
+    }
+
+    static thread_local Zone* tCurrentZone = nullptr;
+
+    static void WriteJsonString(FILE* f, const String& str) {
+        fputc('"', f);
+        for (const char c : str) {
+            if (c == '"' || c == '\\') {
+                fputc('\\', f);
+            }
+            fputc((scast<unsigned char>(c) < 0x20) ? ' ' : c, f);
+        }
+        fputc('"', f);
+    }
+
+
+    bool IsEnabled() {
+        return true;
+    }
+
+    bool WriteChromeJson(const fs::path& path) {
+        FILE* f = fopen(path.u8string().c_str(), "w");
+        if (!f) {
+            return false;
+        }
+
+        Array<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            Registry& registry = GetRegistry();
+            std::lock_guard<std::mutex> guard(registry.lock);
+            buffers = registry.buffers;
+        }
+
+        fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+        bool first = true;
+        for (const std::shared_ptr<ThreadBuffer>& buffer : buffers) {
+            std::lock_guard<std::mutex> guard(buffer->lock);
+
+            const String threadName = buffer->name.empty() ? ("thread " + std::to_string(buffer->tid)) : buffer->name;
+            fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",\n", buffer->tid);
+            WriteJsonString(f, threadName);
+            fprintf(f, "}}");
+            first = false;
+
+            const size_t firstEvent = (buffer->head + sRingCapacity - buffer->count) % sRingCapacity;
+            for (size_t i = 0; i < buffer->count; ++i) {
+                const Event& e = buffer->events[(firstEvent + i) % sRingCapacity];
+
+                fprintf(f, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":", buffer->tid, e.startNs / 1000.0, e.durationNs / 1000.0);
+                WriteJsonString(f, e.name);
+                fprintf(f, ",\"args\":{\"bytes_read\":%llu,\"bytes_written\":%llu,\"pixels\":%llu}}",
+                        scast<unsigned long long>(e.bytesRead), scast<unsigned long long>(e.bytesWritten), scast<unsigned long long>(e.pixels));
+            }
+        }
+
+        fprintf(f, "\n]}\n");
+        const bool result = (0 == ferror(f));
+        fclose(f);
+
+        return result;
+    }
+
+    void Reset() {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> guard(registry.lock);
+        for (const std::shared_ptr<ThreadBuffer>& buffer : registry.buffers) {
+            std::lock_guard<std::mutex> bufferGuard(buffer->lock);
+            buffer->head = 0;
+            buffer->count = 0;
+        }
+    }
+
+    void SetThreadName(const char* name) {
+        ThreadBuffer& buffer = GetThreadBuffer();
+        std::lock_guard<std::mutex> guard(buffer.lock);
+        buffer.name = name;
+    }
+
+
+    Zone::Zone(const char* name)
+        : mName(name)
+        , mStartNs(NowNs())
+        , mBytesRead(0)
+        , mBytesWritten(0)
+        , mPixels(0)
+        , mParent(tCurrentZone)
+    {
+        tCurrentZone = this;
+    }
+    Zone::~Zone() {
+        const uint64_t endNs = NowNs();
+        tCurrentZone = mParent;
+
+        ThreadBuffer& buffer = GetThreadBuffer();
+        std::lock_guard<std::mutex> guard(buffer.lock);
+        buffer.events[buffer.head] = { mName, mStartNs, endNs - mStartNs, mBytesRead, mBytesWritten, mPixels };
+        buffer.head = (buffer.head + 1) % sRingCapacity;
+        buffer.count = Minimum(buffer.count + 1, sRingCapacity);
+    }
+
+    void Zone::AddBytesRead(const uint64_t bytes) {
+        mBytesRead += bytes;
+    }
+
+    void Zone::AddBytesWritten(const uint64_t bytes) {
+        mBytesWritten += bytes;
+    }
+
+    void Zone::AddPixels(const uint64_t pixels) {
+        mPixels += pixels;
+    }
+
+    Zone* Zone::Current() {
+        return tCurrentZone;
+    }
+
+} // namespace Trace
+
+#else
+
+namespace Trace {
+
+    bool IsEnabled() {
+        return false;
+    }
+
+    bool WriteChromeJson(const fs::path&) {
+        return false;
+    }
+
+    void Reset() {
+    }
+
+} // namespace Trace
+
+#endif
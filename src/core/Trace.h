@@ -0,0 +1,68 @@
+#pragma once
+#include "mycommon.h"
+
+// Scoped trace zones, dumped as a Chrome / Perfetto JSON trace (chrome://tracing, ui.perfetto.dev).
+//
+// Compiled out unless ICUBE_ENABLE_TRACE is defined (CMake option of the same name).
+// Every thread records into its own ring buffer, so only the most recent events survive
+// a long session. Counters (bytes read / written, pixels processed) attach to the innermost
+// open zone of the calling thread and end up in the event args.
+//
+//  void Foo() {
+//      TRACE_ZONE("Foo");
+//      ...
+//      TRACE_PIXELS(width * height);
+//  }
+
+namespace Trace {
+
+    // false when tracing is compiled out
+    bool    IsEnabled();
+    // all the threads' events, oldest first; returns false if compiled out or the file can't be written
+    bool    WriteChromeJson(const fs::path& path);
+    // forgets everything recorded so far
+    void    Reset();
+
+#ifdef ICUBE_ENABLE_TRACE
+    class Zone {
+    public:
+        explicit Zone(const char* name);
+        ~Zone();
+
+        void    AddBytesRead(const uint64_t bytes);
+        void    AddBytesWritten(const uint64_t bytes);
+        void    AddPixels(const uint64_t pixels);
+
+        static Zone* Current();
+
+    private:
+        const char* mName;
+        uint64_t    mStartNs;
+        uint64_t    mBytesRead;
+        uint64_t    mBytesWritten;
+        uint64_t    mPixels;
+        Zone*       mParent;
+    };
+
+    void    SetThreadName(const char* name);
+#endif
+
+} // namespace Trace
+
+#ifdef ICUBE_ENABLE_TRACE
+#define TRACE_CONCAT_UTIL_(a, b) a##b
+#define TRACE_CONCAT_(a, b) TRACE_CONCAT_UTIL_(a, b)
+
+// `name` must be a string literal (or otherwise outlive the trace)
+#define TRACE_ZONE(name)            Trace::Zone TRACE_CONCAT_(traceZone_, __LINE__)(name)
+#define TRACE_BYTES_READ(bytes)     do { if (Trace::Zone* z_ = Trace::Zone::Current()) { z_->AddBytesRead(scast<uint64_t>(bytes)); } } while (false)
+#define TRACE_BYTES_WRITTEN(bytes)  do { if (Trace::Zone* z_ = Trace::Zone::Current()) { z_->AddBytesWritten(scast<uint64_t>(bytes)); } } while (false)
+#define TRACE_PIXELS(pixels)        do { if (Trace::Zone* z_ = Trace::Zone::Current()) { z_->AddPixels(scast<uint64_t>(pixels)); } } while (false)
+#define TRACE_THREAD_NAME(name)     Trace::SetThreadName(name)
+#else
+#define TRACE_ZONE(name)
+#define TRACE_BYTES_READ(bytes)     ((void)0)
+#define TRACE_BYTES_WRITTEN(bytes)  ((void)0)
+#define TRACE_PIXELS(pixels)        ((void)0)
+#define TRACE_THREAD_NAME(name)     ((void)0)
+#endif
@@ -8,6 +8,7 @@
 #include <numeric>
 #include <algorithm>
 #include <cassert>
+#include <cctype>
 
 #define STRINGIFY_UTIL_(s) #s
 #define STRINGIFY(s) STRINGIFY_UTIL_(s)
@@ -51,3 +52,16 @@ template <typename T>
 inline T Clamp(const T& value, const T& left, const T& right) {
     return value < left ? left : (value > right ? right : value);
 }
+
+// ASCII only
+inline String ToLowerCase(String str) {
+    std::transform(str.begin(), str.end(), str.begin(), [](const unsigned char c) {
+        return scast<char>(std::tolower(c));
+    });
+    return str;
+}
+
+// lower case, ".HDR" is the same format as ".hdr"
+inline String GetFileFormatExtension(const fs::path& path) {
+    return ToLowerCase(path.extension().u8string());
+}
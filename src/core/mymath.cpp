@@ -0,0 +1,257 @@
+#include "mycommon.h"
+#include "mymath_simd.h"
+
+#include <cmath>
+
+#if MM_SIMD_X64
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace mmsimd {
+
+struct SimdScalar {
+    using F = float;
+    using M = bool;
+    using I = int32_t;
+
+    static const size_t kWidth = 1;
+
+    static F Load(const float* p) { return *p; }
+    static void Store(float* p, const F a) { *p = a; }
+    static F Set(const float a) { return a; }
+
+    static F Add(const F a, const F b) { return a + b; }
+    static F Sub(const F a, const F b) { return a - b; }
+    static F Mul(const F a, const F b) { return a * b; }
+    static F Div(const F a, const F b) { return a / b; }
+    static F MulAdd(const F a, const F b, const F c) { return a * b + c; }
+    static F Sqrt(const F a) { return std::sqrt(a); }
+    static F Min(const F a, const F b) { return Minimum(a, b); }
+    static F Max(const F a, const F b) { return Maximum(a, b); }
+    static F Abs(const F a) { return std::fabs(a); }
+
+    static M Less(const F a, const F b) { return a < b; }
+    static M Greater(const F a, const F b) { return a > b; }
+    static M Equal(const F a, const F b) { return a == b; }
+    static F Select(const M m, const F a, const F b) { return m ? a : b; }
+
+    static I RoundToInt(const F a) { return scast<I>(std::nearbyint(a)); }
+    static F IntToFloat(const I a) { return scast<F>(a); }
+    static I IntAddOne(const I a) { return a + 1; }
+    static M IntBitSet(const I a, const int32_t bit) { return (a & bit) != 0; }
+};
+
+void DirToLatLongSoA_Scalar(const float* x, const float* y, const float* z, float* u, float* v, const size_t n) {
+    DirToLatLongSoA<SimdScalar>(x, y, z, u, v, n);
+}
+void LatLongToDirSoA_Scalar(const float* u, const float* v, float* x, float* y, float* z, const size_t n) {
+    LatLongToDirSoA<SimdScalar>(u, v, x, y, z, n);
+}
+void NormalizeSoA_Scalar(float* x, float* y, float* z, const size_t n) {
+    NormalizeSoA<SimdScalar>(x, y, z, n);
+}
+void DirToCubeFaceSoA_Scalar(const float* x, const float* y, const float* z, float* face, float* u, float* v, const size_t n) {
+    DirToCubeFaceSoA<SimdScalar>(x, y, z, face, u, v, n);
+}
+
+#if MM_SIMD_X64
+// SSE2 is the x64 baseline, no dispatch needed
+struct SimdSSE2 {
+    using F = __m128;
+    using M = __m128;
+    using I = __m128i;
+
+    static const size_t kWidth = 4;
+
+    static F Load(const float* p) { return _mm_loadu_ps(p); }
+    static void Store(float* p, const F a) { _mm_storeu_ps(p, a); }
+    static F Set(const float a) { return _mm_set1_ps(a); }
+
+    static F Add(const F a, const F b) { return _mm_add_ps(a, b); }
+    static F Sub(const F a, const F b) { return _mm_sub_ps(a, b); }
+    static F Mul(const F a, const F b) { return _mm_mul_ps(a, b); }
+    static F Div(const F a, const F b) { return _mm_div_ps(a, b); }
+    static F MulAdd(const F a, const F b, const F c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static F Sqrt(const F a) { return _mm_sqrt_ps(a); }
+    static F Min(const F a, const F b) { return _mm_min_ps(a, b); }
+    static F Max(const F a, const F b) { return _mm_max_ps(a, b); }
+    static F Abs(const F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+    static M Less(const F a, const F b) { return _mm_cmplt_ps(a, b); }
+    static M Greater(const F a, const F b) { return _mm_cmpgt_ps(a, b); }
+    static M Equal(const F a, const F b) { return _mm_cmpeq_ps(a, b); }
+    static F Select(const M m, const F a, const F b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+
+    static I RoundToInt(const F a) { return _mm_cvtps_epi32(a); }
+    static F IntToFloat(const I a) { return _mm_cvtepi32_ps(a); }
+    static I IntAddOne(const I a) { return _mm_add_epi32(a, _mm_set1_epi32(1)); }
+    static M IntBitSet(const I a, const int32_t bit) {
+        const I b = _mm_set1_epi32(bit);
+        return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a, b), b));
+    }
+};
+
+void DirToLatLongSoA_SSE2(const float* x, const float* y, const float* z, float* u, float* v, const size_t n) {
+    DirToLatLongSoA<SimdSSE2>(x, y, z, u, v, n);
+}
+void LatLongToDirSoA_SSE2(const float* u, const float* v, float* x, float* y, float* z, const size_t n) {
+    LatLongToDirSoA<SimdSSE2>(u, v, x, y, z, n);
+}
+void NormalizeSoA_SSE2(float* x, float* y, float* z, const size_t n) {
+    NormalizeSoA<SimdSSE2>(x, y, z, n);
+}
+void DirToCubeFaceSoA_SSE2(const float* x, const float* y, const float* z, float* face, float* u, float* v, const size_t n) {
+    DirToCubeFaceSoA<SimdSSE2>(x, y, z, face, u, v, n);
+}
+
+static bool CpuSupports(const bool avx512) {
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 1);
+    const bool osxsave = (regs[2] & (1 << 27)) != 0;
+    const bool fma = (regs[2] & (1 << 12)) != 0;
+    if (!osxsave || !fma) {
+        return false;
+    }
+    // OS must save the YMM (and for AVX-512 the ZMM/opmask) state
+    const unsigned long long xcr0 = _xgetbv(0);
+    const unsigned long long xcr0Mask = avx512 ? 0xE6ull : 0x06ull;
+    if ((xcr0 & xcr0Mask) != xcr0Mask) {
+        return false;
+    }
+    __cpuidex(regs, 7, 0);
+    return avx512 ? ((regs[1] & (1 << 16)) != 0) : ((regs[1] & (1 << 5)) != 0);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("fma") && (avx512 ? __builtin_cpu_supports("avx512f") : __builtin_cpu_supports("avx2"));
+#endif
+}
+#endif // MM_SIMD_X64
+
+
+struct BatchKernels {
+    void (*dirToLatLong)(const float*, const float*, const float*, float*, float*, const size_t);
+    void (*latLongToDir)(const float*, const float*, float*, float*, float*, const size_t);
+    void (*normalize)(float*, float*, float*, const size_t);
+    void (*dirToCubeFace)(const float*, const float*, const float*, float*, float*, float*, const size_t);
+};
+
+static BatchKernels SelectBatchKernels() {
+#if MM_SIMD_X64
+    if (CpuSupports(true)) {
+        return { DirToLatLongSoA_AVX512, LatLongToDirSoA_AVX512, NormalizeSoA_AVX512, DirToCubeFaceSoA_AVX512 };
+    } else if (CpuSupports(false)) {
+        return { DirToLatLongSoA_AVX2, LatLongToDirSoA_AVX2, NormalizeSoA_AVX2, DirToCubeFaceSoA_AVX2 };
+    } else {
+        return { DirToLatLongSoA_SSE2, LatLongToDirSoA_SSE2, NormalizeSoA_SSE2, DirToCubeFaceSoA_SSE2 };
+    }
+#else
+    return { DirToLatLongSoA_Scalar, LatLongToDirSoA_Scalar, NormalizeSoA_Scalar, DirToCubeFaceSoA_Scalar };
+#endif
+}
+
+static const BatchKernels& GetBatchKernels() {
+    static const BatchKernels sKernels = SelectBatchKernels();
+    return sKernels;
+}
+
+} // namespace mmsimd
+
+
+// AoS batches go through small SoA chunks that stay in L1
+static const size_t sBatchChunkSize = 256;
+
+void DirToLatLongBatch(const vec3* dirs, vec2* latLongs, const size_t count, const MathPrecision precision) {
+    if (precision == MathPrecision::Exact) {
+        for (size_t i = 0; i < count; ++i) {
+            latLongs[i] = DirToLatLong(dirs[i]);
+        }
+        return;
+    }
+
+    float x[sBatchChunkSize], y[sBatchChunkSize], z[sBatchChunkSize];
+    for (size_t offset = 0; offset < count; offset += sBatchChunkSize) {
+        const size_t n = Minimum(sBatchChunkSize, count - offset);
+        for (size_t i = 0; i < n; ++i) {
+            x[i] = dirs[offset + i].x;
+            y[i] = dirs[offset + i].y;
+            z[i] = dirs[offset + i].z;
+        }
+
+        // outputs reuse the x/y arrays, the kernels are in-place safe
+        mmsimd::GetBatchKernels().dirToLatLong(x, y, z, x, y, n);
+
+        for (size_t i = 0; i < n; ++i) {
+            latLongs[offset + i] = vec2(x[i], y[i]);
+        }
+    }
+}
+
+void LatLongToDirBatch(const vec2* latLongs, vec3* dirs, const size_t count, const MathPrecision precision) {
+    if (precision == MathPrecision::Exact) {
+        for (size_t i = 0; i < count; ++i) {
+            dirs[i] = LatLongToDir(latLongs[i]);
+        }
+        return;
+    }
+
+    float u[sBatchChunkSize], v[sBatchChunkSize], x[sBatchChunkSize], y[sBatchChunkSize], z[sBatchChunkSize];
+    for (size_t offset = 0; offset < count; offset += sBatchChunkSize) {
+        const size_t n = Minimum(sBatchChunkSize, count - offset);
+        for (size_t i = 0; i < n; ++i) {
+            u[i] = latLongs[offset + i].x;
+            v[i] = latLongs[offset + i].y;
+        }
+
+        mmsimd::GetBatchKernels().latLongToDir(u, v, x, y, z, n);
+
+        for (size_t i = 0; i < n; ++i) {
+            dirs[offset + i] = vec3(x[i], y[i], z[i]);
+        }
+    }
+}
+
+void DirToLatLongBatch(const float* x, const float* y, const float* z, float* u, float* v, const size_t count, const MathPrecision precision) {
+    if (precision == MathPrecision::Exact) {
+        for (size_t i = 0; i < count; ++i) {
+            const vec2 uv = DirToLatLong(vec3(x[i], y[i], z[i]));
+            u[i] = uv.x;
+            v[i] = uv.y;
+        }
+    } else {
+        mmsimd::GetBatchKernels().dirToLatLong(x, y, z, u, v, count);
+    }
+}
+
+void LatLongToDirBatch(const float* u, const float* v, float* x, float* y, float* z, const size_t count, const MathPrecision precision) {
+    if (precision == MathPrecision::Exact) {
+        for (size_t i = 0; i < count; ++i) {
+            const vec3 dir = LatLongToDir(vec2(u[i], v[i]));
+            x[i] = dir.x;
+            y[i] = dir.y;
+            z[i] = dir.z;
+        }
+    } else {
+        mmsimd::GetBatchKernels().latLongToDir(u, v, x, y, z, count);
+    }
+}
+
+void NormalizeBatch(float* x, float* y, float* z, const size_t count) {
+    mmsimd::GetBatchKernels().normalize(x, y, z, count);
+}
+
+void DirToCubeFaceBatch(const float* x, const float* y, const float* z, uint8_t* faces, float* u, float* v, const size_t count) {
+    float faceIds[sBatchChunkSize];
+    for (size_t offset = 0; offset < count; offset += sBatchChunkSize) {
+        const size_t n = Minimum(sBatchChunkSize, count - offset);
+
+        mmsimd::GetBatchKernels().dirToCubeFace(x + offset, y + offset, z + offset, faceIds, u + offset, v + offset, n);
+
+        for (size_t i = 0; i < n; ++i) {
+            faces[offset + i] = scast<uint8_t>(faceIds[i]);
+        }
+    }
+}
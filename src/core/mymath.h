@@ -144,12 +144,43 @@ inline vec2 DirToLatLong(const vec3& dir) {
     return result;
 }
 
+// LatLongToDir with the trig already evaluated, phi depends only on the column and theta only on the row,
+// so a whole LatLong can be built from two small (sin, cos) tables
+inline vec3 SinCosToDir(const vec2& sinCosPhi, const vec2& sinCosTheta) {
+    vec3 result(-sinCosTheta.x * sinCosPhi.x,
+                 sinCosTheta.y,
+                -sinCosTheta.x * sinCosPhi.y);
+    return result;
+}
+
 inline vec3 LatLongToDir(const vec2& latLong) {
     const float phi = latLong.x * MM_TwoPi;
     const float theta = latLong.y * MM_Pi;
 
-    vec3 result(-std::sinf(theta) * std::sinf(phi),
-                 std::cosf(theta),
-                -std::sinf(theta) * std::cosf(phi));
-    return result;
-}
+    return SinCosToDir(vec2(std::sinf(phi), std::cosf(phi)), vec2(std::sinf(theta), std::cosf(theta)));
+}
+
+
+// Batched direction <-> LatLong mappings.
+//
+// Exact gives bit-identical results to DirToLatLong / LatLongToDir (libm per lane).
+// Fast evaluates polynomial approximations 4/8/16 lanes at a time (SSE2/AVX2/AVX-512,
+// picked at runtime), max absolute error measured over 4M random unit directions / uv pairs:
+//   DirToLatLong - 2.0e-6 in u, 2.5e-7 in v  (atan2 |err| <= 1.0e-5 rad)
+//   LatLongToDir - 2.5e-7 per component
+enum class MathPrecision {
+    Exact,
+    Fast
+};
+
+// AoS
+void DirToLatLongBatch(const vec3* dirs, vec2* latLongs, const size_t count, const MathPrecision precision = MathPrecision::Exact);
+void LatLongToDirBatch(const vec2* latLongs, vec3* dirs, const size_t count, const MathPrecision precision = MathPrecision::Exact);
+// SoA, in-place safe
+void DirToLatLongBatch(const float* x, const float* y, const float* z, float* u, float* v, const size_t count, const MathPrecision precision = MathPrecision::Exact);
+void LatLongToDirBatch(const float* u, const float* v, float* x, float* y, float* z, const size_t count, const MathPrecision precision = MathPrecision::Exact);
+// Always bit-identical to Normalize()
+void NormalizeBatch(float* x, float* y, float* z, const size_t count);
+// Dominant axis cube face (+X, -X, +Y, -Y, +Z, -Z order) and the [0, 1] uv on it, with the
+// u/v axes of the vertical cross layout. Branchless, bit-identical to the scalar face projection.
+void DirToCubeFaceBatch(const float* x, const float* y, const float* z, uint8_t* faces, float* u, float* v, const size_t count);
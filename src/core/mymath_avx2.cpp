@@ -0,0 +1,60 @@
+// Built with AVX2 + FMA enabled (see CMakeLists.txt), only called after a runtime CPU check
+#include "mycommon.h"
+#include "mymath_simd.h"
+
+#if MM_SIMD_X64
+#include <immintrin.h>
+
+namespace mmsimd {
+
+struct SimdAVX2 {
+    using F = __m256;
+    using M = __m256;
+    using I = __m256i;
+
+    static const size_t kWidth = 8;
+
+    static F Load(const float* p) { return _mm256_loadu_ps(p); }
+    static void Store(float* p, const F a) { _mm256_storeu_ps(p, a); }
+    static F Set(const float a) { return _mm256_set1_ps(a); }
+
+    static F Add(const F a, const F b) { return _mm256_add_ps(a, b); }
+    static F Sub(const F a, const F b) { return _mm256_sub_ps(a, b); }
+    static F Mul(const F a, const F b) { return _mm256_mul_ps(a, b); }
+    static F Div(const F a, const F b) { return _mm256_div_ps(a, b); }
+    static F MulAdd(const F a, const F b, const F c) { return _mm256_fmadd_ps(a, b, c); }
+    static F Sqrt(const F a) { return _mm256_sqrt_ps(a); }
+    static F Min(const F a, const F b) { return _mm256_min_ps(a, b); }
+    static F Max(const F a, const F b) { return _mm256_max_ps(a, b); }
+    static F Abs(const F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+    static M Less(const F a, const F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M Greater(const F a, const F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static M Equal(const F a, const F b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static F Select(const M m, const F a, const F b) { return _mm256_blendv_ps(b, a, m); }
+
+    static I RoundToInt(const F a) { return _mm256_cvtps_epi32(a); }
+    static F IntToFloat(const I a) { return _mm256_cvtepi32_ps(a); }
+    static I IntAddOne(const I a) { return _mm256_add_epi32(a, _mm256_set1_epi32(1)); }
+    static M IntBitSet(const I a, const int32_t bit) {
+        const I b = _mm256_set1_epi32(bit);
+        return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(a, b), b));
+    }
+};
+
+void DirToLatLongSoA_AVX2(const float* x, const float* y, const float* z, float* u, float* v, const size_t n) {
+    DirToLatLongSoA<SimdAVX2>(x, y, z, u, v, n);
+}
+void LatLongToDirSoA_AVX2(const float* u, const float* v, float* x, float* y, float* z, const size_t n) {
+    LatLongToDirSoA<SimdAVX2>(u, v, x, y, z, n);
+}
+void NormalizeSoA_AVX2(float* x, float* y, float* z, const size_t n) {
+    NormalizeSoA<SimdAVX2>(x, y, z, n);
+}
+void DirToCubeFaceSoA_AVX2(const float* x, const float* y, const float* z, float* face, float* u, float* v, const size_t n) {
+    DirToCubeFaceSoA<SimdAVX2>(x, y, z, face, u, v, n);
+}
+
+} // namespace mmsimd
+
+#endif // MM_SIMD_X64
@@ -0,0 +1,57 @@
+// Built with AVX-512F enabled (see CMakeLists.txt), only called after a runtime CPU check
+#include "mycommon.h"
+#include "mymath_simd.h"
+
+#if MM_SIMD_X64
+#include <immintrin.h>
+
+namespace mmsimd {
+
+struct SimdAVX512 {
+    using F = __m512;
+    using M = __mmask16;
+    using I = __m512i;
+
+    static const size_t kWidth = 16;
+
+    static F Load(const float* p) { return _mm512_loadu_ps(p); }
+    static void Store(float* p, const F a) { _mm512_storeu_ps(p, a); }
+    static F Set(const float a) { return _mm512_set1_ps(a); }
+
+    static F Add(const F a, const F b) { return _mm512_add_ps(a, b); }
+    static F Sub(const F a, const F b) { return _mm512_sub_ps(a, b); }
+    static F Mul(const F a, const F b) { return _mm512_mul_ps(a, b); }
+    static F Div(const F a, const F b) { return _mm512_div_ps(a, b); }
+    static F MulAdd(const F a, const F b, const F c) { return _mm512_fmadd_ps(a, b, c); }
+    static F Sqrt(const F a) { return _mm512_sqrt_ps(a); }
+    static F Min(const F a, const F b) { return _mm512_min_ps(a, b); }
+    static F Max(const F a, const F b) { return _mm512_max_ps(a, b); }
+    static F Abs(const F a) { return _mm512_abs_ps(a); }
+
+    static M Less(const F a, const F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static M Greater(const F a, const F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+    static M Equal(const F a, const F b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+    static F Select(const M m, const F a, const F b) { return _mm512_mask_blend_ps(m, b, a); }
+
+    static I RoundToInt(const F a) { return _mm512_cvtps_epi32(a); }
+    static F IntToFloat(const I a) { return _mm512_cvtepi32_ps(a); }
+    static I IntAddOne(const I a) { return _mm512_add_epi32(a, _mm512_set1_epi32(1)); }
+    static M IntBitSet(const I a, const int32_t bit) { return _mm512_test_epi32_mask(a, _mm512_set1_epi32(bit)); }
+};
+
+void DirToLatLongSoA_AVX512(const float* x, const float* y, const float* z, float* u, float* v, const size_t n) {
+    DirToLatLongSoA<SimdAVX512>(x, y, z, u, v, n);
+}
+void LatLongToDirSoA_AVX512(const float* u, const float* v, float* x, float* y, float* z, const size_t n) {
+    LatLongToDirSoA<SimdAVX512>(u, v, x, y, z, n);
+}
+void NormalizeSoA_AVX512(float* x, float* y, float* z, const size_t n) {
+    NormalizeSoA<SimdAVX512>(x, y, z, n);
+}
+void DirToCubeFaceSoA_AVX512(const float* x, const float* y, const float* z, float* face, float* u, float* v, const size_t n) {
+    DirToCubeFaceSoA<SimdAVX512>(x, y, z, face, u, v, n);
+}
+
+} // namespace mmsimd
+
+#endif // MM_SIMD_X64
@@ -0,0 +1,305 @@
+#pragma once
+#include "mymath.h"
+
+// Width-agnostic kernels behind the batched direction functions of mymath.h.
+// Every instruction set provides a traits struct (S) with the lane type F, the mask type M,
+// the integer type I and a handful of static ops, and instantiates the kernels below with it
+// in its own translation unit, compiled with the matching target flags.
+//
+// Polynomials (x is the reduced argument):
+//   atan(x), x in [0, 1]  - Abramowitz & Stegun 4.4.49, odd degree 9, |err| <= 1.0e-5 rad
+//   acos(x), x in [0, 1]  - Abramowitz & Stegun 4.4.46, sqrt(1 - x) * P7(x), |err| <= 2.0e-8 rad (+ float rounding)
+//   sin/cos, |x| <= Pi/4  - Cephes sinf/cosf minimax, |err| <= 1 ulp, after Cody-Waite reduction by Pi/2
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MM_SIMD_X64 1
+#else
+#define MM_SIMD_X64 0
+#endif
+
+namespace mmsimd {
+
+// Functions exported by the per-ISA translation units
+void DirToLatLongSoA_SSE2(const float* x, const float* y, const float* z, float* u, float* v, const size_t n);
+void LatLongToDirSoA_SSE2(const float* u, const float* v, float* x, float* y, float* z, const size_t n);
+void NormalizeSoA_SSE2(float* x, float* y, float* z, const size_t n);
+void DirToCubeFaceSoA_SSE2(const float* x, const float* y, const float* z, float* face, float* u, float* v, const size_t n);
+
+void DirToLatLongSoA_AVX2(const float* x, const float* y, const float* z, float* u, float* v, const size_t n);
+void LatLongToDirSoA_AVX2(const float* u, const float* v, float* x, float* y, float* z, const size_t n);
+void NormalizeSoA_AVX2(float* x, float* y, float* z, const size_t n);
+void DirToCubeFaceSoA_AVX2(const float* x, const float* y, const float* z, float* face, float* u, float* v, const size_t n);
+
+void DirToLatLongSoA_AVX512(const float* x, const float* y, const float* z, float* u, float* v, const size_t n);
+void LatLongToDirSoA_AVX512(const float* u, const float* v, float* x, float* y, float* z, const size_t n);
+void NormalizeSoA_AVX512(float* x, float* y, float* z, const size_t n);
+void DirToCubeFaceSoA_AVX512(const float* x, const float* y, const float* z, float* face, float* u, float* v, const size_t n);
+
+void DirToLatLongSoA_Scalar(const float* x, const float* y, const float* z, float* u, float* v, const size_t n);
+void LatLongToDirSoA_Scalar(const float* u, const float* v, float* x, float* y, float* z, const size_t n);
+void NormalizeSoA_Scalar(float* x, float* y, float* z, const size_t n);
+void DirToCubeFaceSoA_Scalar(const float* x, const float* y, const float* z, float* face, float* u, float* v, const size_t n);
+
+
+// Runs `full(offset)` over all the full vectors, then `tail(offset, count)` for the rest,
+// which goes through a padded copy so the kernels never read or write out of bounds.
+template <size_t W, typename FullFunc, typename TailFunc>
+inline void ForEachVector(const size_t n, FullFunc full, TailFunc tail) {
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        full(i);
+    }
+    if (i < n) {
+        tail(i, n - i);
+    }
+}
+
+
+template <typename S>
+inline typename S::F AtanUnit(const typename S::F x) {
+    using F = typename S::F;
+    const F x2 = S::Mul(x, x);
+    F p = S::Set(0.0208351f);
+    p = S::MulAdd(p, x2, S::Set(-0.0851330f));
+    p = S::MulAdd(p, x2, S::Set(0.1801410f));
+    p = S::MulAdd(p, x2, S::Set(-0.3302995f));
+    p = S::MulAdd(p, x2, S::Set(0.9998660f));
+    return S::Mul(p, x);
+}
+
+template <typename S>
+inline typename S::F Atan2(const typename S::F y, const typename S::F x) {
+    using F = typename S::F;
+    const F ax = S::Abs(x);
+    const F ay = S::Abs(y);
+    const F mn = S::Min(ax, ay);
+    const F mx = S::Max(S::Max(ax, ay), S::Set(MM_Epsilon * MM_Epsilon));
+
+    F r = AtanUnit<S>(S::Div(mn, mx));
+    r = S::Select(S::Greater(ay, ax), S::Sub(S::Set(MM_HalfPi), r), r);
+    r = S::Select(S::Less(x, S::Set(0.0f)), S::Sub(S::Set(MM_Pi), r), r);
+    r = S::Select(S::Less(y, S::Set(0.0f)), S::Sub(S::Set(0.0f), r), r);
+    return r;
+}
+
+template <typename S>
+inline typename S::F Acos(const typename S::F x) {
+    using F = typename S::F;
+    const F cx = S::Min(S::Max(x, S::Set(-1.0f)), S::Set(1.0f));
+    const F ax = S::Abs(cx);
+
+    F p = S::Set(-0.0012624911f);
+    p = S::MulAdd(p, ax, S::Set(0.0066700901f));
+    p = S::MulAdd(p, ax, S::Set(-0.0170881256f));
+    p = S::MulAdd(p, ax, S::Set(0.0308918810f));
+    p = S::MulAdd(p, ax, S::Set(-0.0501743046f));
+    p = S::MulAdd(p, ax, S::Set(0.0889789874f));
+    p = S::MulAdd(p, ax, S::Set(-0.2145988016f));
+    p = S::MulAdd(p, ax, S::Set(1.5707963050f));
+
+    const F r = S::Mul(S::Sqrt(S::Sub(S::Set(1.0f), ax)), p);
+    return S::Select(S::Less(cx, S::Set(0.0f)), S::Sub(S::Set(MM_Pi), r), r);
+}
+
+template <typename S>
+inline void SinCos(const typename S::F x, typename S::F& outSin, typename S::F& outCos) {
+    using F = typename S::F;
+    using I = typename S::I;
+
+    // x = k * Pi/2 + r, Pi/2 split in three parts to keep r exact
+    const I k = S::RoundToInt(S::Mul(x, S::Set(2.0f / MM_Pi)));
+    const F fk = S::IntToFloat(k);
+    F r = S::MulAdd(fk, S::Set(-1.5703125f), x);
+    r = S::MulAdd(fk, S::Set(-4.837512969970703125e-4f), r);
+    r = S::MulAdd(fk, S::Set(-7.54978995489188216e-8f), r);
+
+    const F r2 = S::Mul(r, r);
+
+    F ps = S::Set(-1.9515295891e-4f);
+    ps = S::MulAdd(ps, r2, S::Set(8.3321608736e-3f));
+    ps = S::MulAdd(ps, r2, S::Set(-1.6666654611e-1f));
+    const F sinR = S::MulAdd(S::Mul(ps, r2), r, r);
+
+    F pc = S::Set(2.443315711809948e-5f);
+    pc = S::MulAdd(pc, r2, S::Set(-1.388731625493765e-3f));
+    pc = S::MulAdd(pc, r2, S::Set(4.166664568298827e-2f));
+    const F cosR = S::MulAdd(S::Mul(pc, r2), r2, S::MulAdd(r2, S::Set(-0.5f), S::Set(1.0f)));
+
+    // quadrant: odd k swaps sin and cos, then the signs follow k & 2 and (k + 1) & 2
+    const typename S::M swap = S::IntBitSet(k, 1);
+    const F s = S::Select(swap, cosR, sinR);
+    const F c = S::Select(swap, sinR, cosR);
+    outSin = S::Select(S::IntBitSet(k, 2), S::Sub(S::Set(0.0f), s), s);
+    outCos = S::Select(S::IntBitSet(S::IntAddOne(k), 2), S::Sub(S::Set(0.0f), c), c);
+}
+
+
+template <typename S>
+inline void DirToLatLongVector(const float* x, const float* y, const float* z, float* u, float* v) {
+    using F = typename S::F;
+    const F phi = Atan2<S>(S::Load(x), S::Load(z));
+    const F theta = Acos<S>(S::Load(y));
+    S::Store(u, S::Mul(S::Add(S::Set(MM_Pi), phi), S::Set(0.5f / MM_Pi)));
+    S::Store(v, S::Mul(theta, S::Set(MM_InvPi)));
+}
+
+template <typename S>
+inline void LatLongToDirVector(const float* u, const float* v, float* x, float* y, float* z) {
+    using F = typename S::F;
+    F sinPhi, cosPhi, sinTheta, cosTheta;
+    SinCos<S>(S::Mul(S::Load(u), S::Set(MM_TwoPi)), sinPhi, cosPhi);
+    SinCos<S>(S::Mul(S::Load(v), S::Set(MM_Pi)), sinTheta, cosTheta);
+    S::Store(x, S::Sub(S::Set(0.0f), S::Mul(sinTheta, sinPhi)));
+    S::Store(y, cosTheta);
+    S::Store(z, S::Sub(S::Set(0.0f), S::Mul(sinTheta, cosPhi)));
+}
+
+// Same op order as glm::normalize (v * (1 / sqrt(dot(v, v)))), so the result is bit-identical to Normalize()
+template <typename S>
+inline void NormalizeVector(float* x, float* y, float* z) {
+    using F = typename S::F;
+    const F vx = S::Load(x);
+    const F vy = S::Load(y);
+    const F vz = S::Load(z);
+    const F lenSq = S::Add(S::Add(S::Mul(vx, vx), S::Mul(vy, vy)), S::Mul(vz, vz));
+    const F invLen = S::Div(S::Set(1.0f), S::Sqrt(lenSq));
+    S::Store(x, S::Mul(vx, invLen));
+    S::Store(y, S::Mul(vy, invLen));
+    S::Store(z, S::Mul(vz, invLen));
+}
+
+
+// Branchless version of the dominant axis selection, same tie order (X, then Y, then Z) and
+// same float ops as the scalar projection, so the face uv is bit-identical to it.
+// The face id is returned as a float to stay in the float lanes.
+template <typename S>
+inline void DirToCubeFaceVector(const float* x, const float* y, const float* z, float* face, float* u, float* v) {
+    using F = typename S::F;
+    using M = typename S::M;
+    const F zero = S::Set(0.0f);
+    const F vx = S::Load(x);
+    const F vy = S::Load(y);
+    const F vz = S::Load(z);
+
+    const F maxAxis = S::Max(S::Max(S::Abs(vx), S::Abs(vy)), S::Abs(vz));
+    const M isX = S::Equal(S::Abs(vx), maxAxis);
+    const M isY = S::Equal(S::Abs(vy), maxAxis);
+
+    const F fx = S::Div(vx, maxAxis);
+    const F fy = S::Div(vy, maxAxis);
+    const F fz = S::Div(vz, maxAxis);
+
+    const M negX = S::Less(vx, zero);
+    const M negY = S::Less(vy, zero);
+    const M negZ = S::Less(vz, zero);
+
+    // +X: (-z, -y)  -X: (z, -y)  +Y: (x, z)  -Y: (x, -z)  +Z: (x, -y)  -Z: (-x, -y)
+    const F faceX = S::Select(negX, S::Set(1.0f), S::Set(0.0f));
+    const F faceY = S::Select(negY, S::Set(3.0f), S::Set(2.0f));
+    const F faceZ = S::Select(negZ, S::Set(5.0f), S::Set(4.0f));
+    const F uX = S::Select(negX, fz, S::Sub(zero, fz));
+    const F uZ = S::Select(negZ, S::Sub(zero, fx), fx);
+    const F vY = S::Select(negY, S::Sub(zero, fz), fz);
+    const F vXZ = S::Sub(zero, fy);
+
+    const F fu = S::Select(isX, uX, S::Select(isY, fx, uZ));
+    const F fv = S::Select(isX, vXZ, S::Select(isY, vY, vXZ));
+
+    S::Store(face, S::Select(isX, faceX, S::Select(isY, faceY, faceZ)));
+    S::Store(u, S::Mul(S::Add(fu, S::Set(1.0f)), S::Set(0.5f)));
+    S::Store(v, S::Mul(S::Add(fv, S::Set(1.0f)), S::Set(0.5f)));
+}
+
+
+// NOTE: no std:: algorithms in here - a shared inline instantiation compiled with AVX flags
+//       could be picked by the linker for the baseline code too.
+template <typename S>
+inline void DirToLatLongSoA(const float* x, const float* y, const float* z, float* u, float* v, const size_t n) {
+    constexpr size_t W = S::kWidth;
+    ForEachVector<W>(n, [&](const size_t i) {
+        DirToLatLongVector<S>(x + i, y + i, z + i, u + i, v + i);
+    }, [&](const size_t i, const size_t count) {
+        float tx[W] = {}, ty[W] = {}, tz[W] = {}, tu[W], tv[W];
+        for (size_t j = 0; j < count; ++j) {
+            tx[j] = x[i + j];
+            ty[j] = y[i + j];
+            tz[j] = z[i + j];
+        }
+        DirToLatLongVector<S>(tx, ty, tz, tu, tv);
+        for (size_t j = 0; j < count; ++j) {
+            u[i + j] = tu[j];
+            v[i + j] = tv[j];
+        }
+    });
+}
+
+template <typename S>
+inline void LatLongToDirSoA(const float* u, const float* v, float* x, float* y, float* z, const size_t n) {
+    constexpr size_t W = S::kWidth;
+    ForEachVector<W>(n, [&](const size_t i) {
+        LatLongToDirVector<S>(u + i, v + i, x + i, y + i, z + i);
+    }, [&](const size_t i, const size_t count) {
+        float tu[W] = {}, tv[W] = {}, tx[W], ty[W], tz[W];
+        for (size_t j = 0; j < count; ++j) {
+            tu[j] = u[i + j];
+            tv[j] = v[i + j];
+        }
+        LatLongToDirVector<S>(tu, tv, tx, ty, tz);
+        for (size_t j = 0; j < count; ++j) {
+            x[i + j] = tx[j];
+            y[i + j] = ty[j];
+            z[i + j] = tz[j];
+        }
+    });
+}
+
+template <typename S>
+inline void NormalizeSoA(float* x, float* y, float* z, const size_t n) {
+    constexpr size_t W = S::kWidth;
+    ForEachVector<W>(n, [&](const size_t i) {
+        NormalizeVector<S>(x + i, y + i, z + i);
+    }, [&](const size_t i, const size_t count) {
+        // padding lanes get a unit vector to keep them finite
+        float tx[W], ty[W] = {}, tz[W] = {};
+        for (size_t j = 0; j < W; ++j) {
+            tx[j] = 1.0f;
+        }
+        for (size_t j = 0; j < count; ++j) {
+            tx[j] = x[i + j];
+            ty[j] = y[i + j];
+            tz[j] = z[i + j];
+        }
+        NormalizeVector<S>(tx, ty, tz);
+        for (size_t j = 0; j < count; ++j) {
+            x[i + j] = tx[j];
+            y[i + j] = ty[j];
+            z[i + j] = tz[j];
+        }
+    });
+}
+
+template <typename S>
+inline void DirToCubeFaceSoA(const float* x, const float* y, const float* z, float* face, float* u, float* v, const size_t n) {
+    constexpr size_t W = S::kWidth;
+    ForEachVector<W>(n, [&](const size_t i) {
+        DirToCubeFaceVector<S>(x + i, y + i, z + i, face + i, u + i, v + i);
+    }, [&](const size_t i, const size_t count) {
+        float tx[W], ty[W] = {}, tz[W] = {}, tf[W], tu[W], tv[W];
+        for (size_t j = 0; j < W; ++j) {
+            tx[j] = 1.0f;
+        }
+        for (size_t j = 0; j < count; ++j) {
+            tx[j] = x[i + j];
+            ty[j] = y[i + j];
+            tz[j] = z[i + j];
+        }
+        DirToCubeFaceVector<S>(tx, ty, tz, tf, tu, tv);
+        for (size_t j = 0; j < count; ++j) {
+            face[i + j] = tf[j];
+            u[i + j] = tu[j];
+            v[i + j] = tv[j];
+        }
+    });
+}
+
+} // namespace mmsimd
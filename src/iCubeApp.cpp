@@ -10,8 +10,15 @@
 
 #include "nfd.h"
 
+#include "GLState.h"
+#include "Trace.h"
+
+#include <cstring>
 #include <iostream>
 
+// ImGui needs a couple of frames to settle after an input (hover, layout, click on release)
+static const int sRedrawFramesOnInput = 3;
+
 void GLAPIENTRY MessageCallback(GLenum source,
                                 GLenum type,
                                 GLuint id,
@@ -31,19 +38,30 @@ iCubeApp::iCubeApp()
     : mWindow(nullptr)
     , mWidth(1280)
     , mHeight(720)
+    , mRedrawFrames(sRedrawFramesOnInput)
+    , mMaxFrameRate(60)
+    , mLdrExport(GetDefaultLdrExportSettings())
+    , mEnvImg(std::make_shared<EnvironmentImage>())
+    , mJobPanel(JobPanel::None)
     , mViewerPanelBounds(0.0f)
     , mCubeFacesPanelBounds(0.0f)
     , mLastMPos(0.0f)
     , mDrawFacesShader(GL_NONE)
+    , mDrawFacesUniforms({ -1, -1 })
     , mJunkVAO(GL_NONE)
     , mCubeFacesMouseDown(false)
     , mCubeFacesRotation(0.0f)
+    // LatLong / cross panels
+    , mLatLongPanelShader(GL_NONE)
+    , mCrossPanelShader(GL_NONE)
+    , mLatLongImageRect(0.0f)
+    , mCrossImageRect(0.0f)
     // viewer
     , mViewerObjectShader(GL_NONE)
+    , mViewerObjectUniforms({ -1, -1 })
     , mViewerVAO(GL_NONE)
     , mViewerVB(GL_NONE)
     , mViewerIB(GL_NONE)
-    , mViewerNumIndices(0)
     , mViewerMouseDown(false)
     , mViewerRotation(0.0f)
 {
@@ -83,12 +101,17 @@ bool iCubeApp::Initialize() {
     glEnable(GL_DEBUG_OUTPUT);
     glDebugMessageCallback(MessageCallback, 0);
 
-    glViewport(0, 0, mWidth, mHeight);
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glActiveTexture(GL_TEXTURE0);
-    glBindSampler(0, 0);
+    // from here on the tracked state only changes through GLState
+    GLState& state = GLState::Get();
+    state.Invalidate();
+    state.Viewport(0, 0, mWidth, mHeight);
+    state.SetEnabled(GL_BLEND, true);
+    state.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.SetEnabled(GL_CULL_FACE, false);
+    state.SetEnabled(GL_DEPTH_TEST, false);
+    state.SetEnabled(GL_SCISSOR_TEST, false);   // the ImGui backend puts it back after rendering, glClear needs it off
+    state.ActiveTexture(GL_TEXTURE0);
+    state.BindSampler(0, 0);
 
     this->PrepareRenderer();
 
@@ -115,6 +138,31 @@ bool iCubeApp::Initialize() {
             _this->OnMouseButton(button, action, mods);
         }
     });
+    // the rest of the input only has to wake the UI up, ImGui chains to these
+    glfwSetScrollCallback(scast<GLFWwindow*>(mWindow), [](GLFWwindow* wnd, double, double) {
+        iCubeApp* _this = scast<iCubeApp*>(glfwGetWindowUserPointer(wnd));
+        if (_this) {
+            _this->RequestRedraw();
+        }
+    });
+    glfwSetKeyCallback(scast<GLFWwindow*>(mWindow), [](GLFWwindow* wnd, int, int, int, int) {
+        iCubeApp* _this = scast<iCubeApp*>(glfwGetWindowUserPointer(wnd));
+        if (_this) {
+            _this->RequestRedraw();
+        }
+    });
+    glfwSetCharCallback(scast<GLFWwindow*>(mWindow), [](GLFWwindow* wnd, unsigned int) {
+        iCubeApp* _this = scast<iCubeApp*>(glfwGetWindowUserPointer(wnd));
+        if (_this) {
+            _this->RequestRedraw();
+        }
+    });
+    glfwSetWindowRefreshCallback(scast<GLFWwindow*>(mWindow), [](GLFWwindow* wnd) {
+        iCubeApp* _this = scast<iCubeApp*>(glfwGetWindowUserPointer(wnd));
+        if (_this) {
+            _this->RequestRedraw();
+        }
+    });
 
     // Setup Platform/Renderer bindings
     ImGui_ImplGlfw_InitForOpenGL(scast<GLFWwindow*>(mWindow), true);
@@ -125,9 +173,19 @@ bool iCubeApp::Initialize() {
 
 void iCubeApp::Loop() {
     double lastTimerValue = glfwGetTime();
+    double lastDrawTime = lastTimerValue;
 
     while(GL_FALSE == glfwWindowShouldClose(scast<GLFWwindow*>(mWindow))) {
-        glfwPollEvents();
+        // Input redraws right away (vsync paces them), animations (job progress, streaming uploads)
+        // are capped at mMaxFrameRate, and with neither we sleep until the next event
+        const double frameInterval = 1.0 / scast<double>(Maximum(mMaxFrameRate, 1));
+        if (mRedrawFrames > 0) {
+            glfwPollEvents();
+        } else if (this->IsAnimating()) {
+            glfwWaitEventsTimeout(Maximum(lastDrawTime + frameInterval - glfwGetTime(), 0.0));
+        } else {
+            glfwWaitEvents();
+        }
 
         const double currentTimerValue = glfwGetTime();
         const double dt = currentTimerValue - lastTimerValue;
@@ -135,6 +193,16 @@ void iCubeApp::Loop() {
 
         this->OnUpdate(scast<float>(dt));
 
+        const bool animationDue = this->IsAnimating() && (currentTimerValue - lastDrawTime) >= frameInterval;
+        if (mRedrawFrames <= 0 && !animationDue) {
+            continue;
+        }
+
+        mRedrawFrames = Maximum(mRedrawFrames - 1, 0);
+        lastDrawTime = currentTimerValue;
+
+        TRACE_ZONE("Frame");
+
         glClearColor(0.412f, 0.796f, 1.0f, 1.0f);
         glClearDepthf(1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -147,13 +215,22 @@ void iCubeApp::Loop() {
         this->DoUI();
 
         ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            TRACE_ZONE("Render UI");
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
         glfwSwapBuffers(scast<GLFWwindow*>(mWindow));
     }
 }
 
 void iCubeApp::Shutdown() {
+    this->CancelJob();
+
+    mEnvTextures.Free();
+    mCubeFacesTarget.Shutdown();
+    mViewerTarget.Shutdown();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -162,27 +239,24 @@ void iCubeApp::Shutdown() {
         glDeleteProgram(mDrawFacesShader);
         mDrawFacesShader = GL_NONE;
     }
-    if (mJunkVAO != GL_NONE) {
-        glDeleteVertexArrays(1, &mJunkVAO);
-        mJunkVAO = GL_NONE;
+    GLState::Get().DeleteVertexArray(mJunkVAO);
+
+    if (mLatLongPanelShader != GL_NONE) {
+        glDeleteProgram(mLatLongPanelShader);
+        mLatLongPanelShader = GL_NONE;
+    }
+    if (mCrossPanelShader != GL_NONE) {
+        glDeleteProgram(mCrossPanelShader);
+        mCrossPanelShader = GL_NONE;
     }
 
     if (mViewerObjectShader != GL_NONE) {
         glDeleteProgram(mViewerObjectShader);
         mViewerObjectShader = GL_NONE;
     }
-    if (mViewerVAO != GL_NONE) {
-        glDeleteVertexArrays(1, &mViewerVAO);
-        mViewerVAO = GL_NONE;
-    }
-    if (mViewerVB != GL_NONE) {
-        glDeleteBuffers(1, &mViewerVB);
-        mViewerVB = GL_NONE;
-    }
-    if (mViewerIB != GL_NONE) {
-        glDeleteBuffers(1, &mViewerIB);
-        mViewerIB = GL_NONE;
-    }
+    GLState::Get().DeleteVertexArray(mViewerVAO);
+    GLState::Get().DeleteBuffer(mViewerVB);
+    GLState::Get().DeleteBuffer(mViewerIB);
 
     glfwDestroyWindow(scast<GLFWwindow*>(mWindow));
     glfwTerminate();
@@ -195,10 +269,14 @@ void iCubeApp::OnResize(const int width, const int height) {
     mWidth = width;
     mHeight = height;
 
-    glViewport(0, 0, mWidth, mHeight);
+    GLState::Get().Viewport(0, 0, mWidth, mHeight);
+
+    this->RequestRedraw();
 }
 
 void iCubeApp::OnSetCursorPos(const float x, const float y) {
+    this->RequestRedraw();
+
     vec2 curMPos(x, y);
     vec2 mouseMove = curMPos - mLastMPos;
     mLastMPos = curMPos;
@@ -211,6 +289,8 @@ void iCubeApp::OnSetCursorPos(const float x, const float y) {
 }
 
 void iCubeApp::OnMouseButton(const int button, const int action, const int mods) {
+    this->RequestRedraw();
+
     if (0 == button && GLFW_PRESS == action) {
         if (!ImGui::IsWindowHovered(ImGuiHoveredFlags_ChildWindows)) {
             if (mLastMPos.x > mCubeFacesPanelBounds.x &&
@@ -233,7 +313,16 @@ void iCubeApp::OnMouseButton(const int button, const int action, const int mods)
 }
 
 void iCubeApp::OnUpdate(const float dt) {
-    // nothing here yet
+    this->PollJob();
+    mEnvTextures.Update(*mEnvImg);
+}
+
+void iCubeApp::RequestRedraw() {
+    mRedrawFrames = sRedrawFramesOnInput;
+}
+
+bool iCubeApp::IsAnimating() const {
+    return this->IsJobRunning() || mEnvTextures.IsUploading();
 }
 
 
@@ -247,36 +336,53 @@ void iCubeApp::DoUI() {
     ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
     ImGui::SetNextWindowSize(ImVec2(kHalfScreenW, kHalfScreenH));
     ImGui::Begin("Viewer:", nullptr, kPanelFlags); {
-        if (!mEnvImg.IsEmpty()) {
-            ImGuiWindow* window = ImGui::GetCurrentWindow();
-            window->DrawList->AddCallback([](const ImDrawList* parent_list, const ImDrawCmd* cmd) {
-                const ImVec2& displPos = ImGui::GetDrawData()->DisplayPos;
-                const ImVec2& displScale = ImGui::GetDrawData()->FramebufferScale;
+        if (!mEnvImg->IsEmpty()) {
+            const PanelView view = this->GetPanelView(mViewerRotation);
+            this->DoPanelTarget(mViewerTarget, view, mViewerPanelBounds, [this](const size_t width, const size_t height) {
+                this->DrawPreviewPanel(width, height);
+            });
+        }
 
-                vec4 clipRect((cmd->ClipRect.x - displPos.x) * displScale.x,
-                              (cmd->ClipRect.y - displPos.y) * displScale.y,
-                              (cmd->ClipRect.z - displPos.x) * displScale.x,
-                              (cmd->ClipRect.w - displPos.y) * displScale.y);
+        ImGui::Text("%.1f FPS (%.3f ms)", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
 
-                iCubeApp* _this = scast<iCubeApp*>(cmd->UserCallbackData);
-                _this->DrawPreviewPanel(clipRect);
-            }, this);
+        // same order as PackedFormat
+        int displayFormat = scast<int>(mEnvTextures.GetFormat());
+        ImGui::SetNextItemWidth(150.0f);
+        if (ImGui::Combo("Display format", &displayFormat, "RGB32F (exact)\0RGBA16F\0R11G11B10F\0RGB9E5\0")) {
+            mEnvTextures.SetFormat(scast<PackedFormat>(displayFormat));
+        }
 
-            // reset state
-            window->DrawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+        ImGui::SetNextItemWidth(150.0f);
+        ImGui::SliderInt("Max animation FPS", &mMaxFrameRate, 10, 240);
+
+        // LDR exports only, same order as ToneMapOperator / DitherMode
+        ImGui::SetNextItemWidth(150.0f);
+        ImGui::SliderFloat("LDR exposure", &mLdrExport.exposure, -8.0f, 8.0f, "%.1f EV");
+        int toneMap = scast<int>(mLdrExport.toneMap);
+        ImGui::SetNextItemWidth(150.0f);
+        if (ImGui::Combo("LDR tone map", &toneMap, "Clamp\0Reinhard\0ACES\0")) {
+            mLdrExport.toneMap = scast<ToneMapOperator>(toneMap);
+        }
+        int dither = scast<int>(mLdrExport.dither);
+        ImGui::SetNextItemWidth(150.0f);
+        if (ImGui::Combo("LDR dither", &dither, "None\0Ordered\0Blue noise\0")) {
+            mLdrExport.dither = scast<DitherMode>(dither);
         }
+        ImGui::Checkbox("LDR sRGB", &mLdrExport.sRGB);
 
-        ImGui::Text("%.1f FPS (%.3f ms)", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
+        if (Trace::IsEnabled() && ImGui::Button("Save trace")) {
+            this->SaveTrace();
+        }
     } ImGui::End();
 
     // LatLong panel [RT]
     ImGui::SetNextWindowPos(ImVec2(kHalfScreenW, 0.0f));
     ImGui::SetNextWindowSize(ImVec2(kHalfScreenW, kHalfScreenH));
     ImGui::Begin("LatLong:", nullptr, kPanelFlags); {
-        const ImTextureID texture = rcast<ImTextureID>(scast<size_t>(mEnvImg.GetTextureLatLong()));
-        if (texture) {
-            const float textureWidth = scast<float>(mEnvImg.GetLatLongWidth());
-            const float textureHeight = scast<float>(mEnvImg.GetLatLongHeight());
+        // drawn straight from the cube map, there's no texture of this projection
+        if (!mEnvImg->IsEmpty() && mEnvTextures.GetCubeMap(*mEnvImg)) {
+            const float textureWidth = scast<float>(mEnvImg->GetLatLongWidth());
+            const float textureHeight = scast<float>(mEnvImg->GetLatLongHeight());
             const float textureRatio = textureWidth / textureHeight;
 
             ImVec2 wndMin = ImGui::GetWindowContentRegionMin();
@@ -288,17 +394,26 @@ void iCubeApp::DoUI() {
             ImVec2 imgSize = ImVec2(textureWidth * scale, textureHeight * scale);
             ImVec2 imgPos = ImVec2((wndSize.x - imgSize.x) * 0.5f + wndMin.x, (wndSize.y - imgSize.y) * 0.5f + wndMin.y);
 
-            ImGui::SetCursorPos(imgPos);
-            ImGui::Image(texture, imgSize);
+            const ImVec2 wndPos = ImGui::GetWindowPos();
+            mLatLongImageRect = vec4(wndPos.x + imgPos.x, wndPos.y + imgPos.y, wndPos.x + imgPos.x + imgSize.x, wndPos.y + imgPos.y + imgSize.y);
 
-            ImGui::SetCursorPos(wndMin);
-        }
+            ImGuiWindow* window = ImGui::GetCurrentWindow();
+            window->DrawList->AddCallback([](const ImDrawList* parent_list, const ImDrawCmd* cmd) {
+                iCubeApp* _this = scast<iCubeApp*>(cmd->UserCallbackData);
+                _this->DrawLatLongPanel(_this->mLatLongImageRect);
+            }, this);
 
-        if (ImGui::Button("Import##LatLong")) {
-            this->ImportLatLong();
+            // reset state
+            window->DrawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
         }
-        if (ImGui::Button("Export##LatLong")) {
-            this->ExportLatLong();
+
+        if (this->DoJobUI(JobPanel::LatLong)) {
+            if (ImGui::Button("Import##LatLong")) {
+                this->ImportLatLong();
+            }
+            if (ImGui::Button("Export##LatLong")) {
+                this->ExportLatLong();
+            }
         }
     } ImGui::End();
 
@@ -306,10 +421,10 @@ void iCubeApp::DoUI() {
     ImGui::SetNextWindowPos(ImVec2(0.0f, kHalfScreenH));
     ImGui::SetNextWindowSize(ImVec2(kHalfScreenW, kHalfScreenH));
     ImGui::Begin("Cube Cross:", nullptr, kPanelFlags); {
-        const ImTextureID texture = rcast<ImTextureID>(scast<size_t>(mEnvImg.GetTextureCubeCross()));
-        if (texture) {
-            const float textureWidth = scast<float>(mEnvImg.GetCubeCrossWidth());
-            const float textureHeight = scast<float>(mEnvImg.GetCubeCrossHeight());
+        // drawn straight from the cube map, there's no texture of this projection
+        if (!mEnvImg->IsEmpty() && mEnvTextures.GetCubeMap(*mEnvImg)) {
+            const float textureWidth = scast<float>(mEnvImg->GetCubeCrossWidth());
+            const float textureHeight = scast<float>(mEnvImg->GetCubeCrossHeight());
             const float textureRatio = textureWidth / textureHeight;
 
             ImVec2 wndMin = ImGui::GetWindowContentRegionMin();
@@ -321,17 +436,26 @@ void iCubeApp::DoUI() {
             ImVec2 imgSize = ImVec2(textureWidth * scale, textureHeight * scale);
             ImVec2 imgPos = ImVec2((wndSize.x - imgSize.x) * 0.5f + wndMin.x, (wndSize.y - imgSize.y) * 0.5f + wndMin.y);
 
-            ImGui::SetCursorPos(imgPos);
-            ImGui::Image(texture, imgSize);
+            const ImVec2 wndPos = ImGui::GetWindowPos();
+            mCrossImageRect = vec4(wndPos.x + imgPos.x, wndPos.y + imgPos.y, wndPos.x + imgPos.x + imgSize.x, wndPos.y + imgPos.y + imgSize.y);
 
-            ImGui::SetCursorPos(wndMin);
-        }
+            ImGuiWindow* window = ImGui::GetCurrentWindow();
+            window->DrawList->AddCallback([](const ImDrawList* parent_list, const ImDrawCmd* cmd) {
+                iCubeApp* _this = scast<iCubeApp*>(cmd->UserCallbackData);
+                _this->DrawCrossPanel(_this->mCrossImageRect);
+            }, this);
 
-        if (ImGui::Button("Import##CubeCross")) {
-            this->ImportCubeCross();
+            // reset state
+            window->DrawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
         }
-        if (ImGui::Button("Export##CubeCross")) {
-            this->ExportCubeCross();
+
+        if (this->DoJobUI(JobPanel::CubeCross)) {
+            if (ImGui::Button("Import##CubeCross")) {
+                this->ImportCubeCross();
+            }
+            if (ImGui::Button("Export##CubeCross")) {
+                this->ExportCubeCross();
+            }
         }
     } ImGui::End();
 
@@ -339,128 +463,303 @@ void iCubeApp::DoUI() {
     ImGui::SetNextWindowPos(ImVec2(kHalfScreenW, kHalfScreenH));
     ImGui::SetNextWindowSize(ImVec2(kHalfScreenW, kHalfScreenH));
     ImGui::Begin("Cube Faces:", nullptr, kPanelFlags); {
-        const ImTextureID texture = rcast<ImTextureID>(scast<size_t>(mEnvImg.GetTextureCubeMap()));
-        if (texture) {
-            ImGuiWindow* window = ImGui::GetCurrentWindow();
-            window->DrawList->AddCallback([](const ImDrawList* parent_list, const ImDrawCmd* cmd) {
-                const ImVec2& displPos = ImGui::GetDrawData()->DisplayPos;
-                const ImVec2& displScale = ImGui::GetDrawData()->FramebufferScale;
-
-                vec4 clipRect((cmd->ClipRect.x - displPos.x) * displScale.x,
-                              (cmd->ClipRect.y - displPos.y) * displScale.y,
-                              (cmd->ClipRect.z - displPos.x) * displScale.x,
-                              (cmd->ClipRect.w - displPos.y) * displScale.y);
-
-                iCubeApp* _this = scast<iCubeApp*>(cmd->UserCallbackData);
-                _this->DrawCubeFaces(clipRect);
-            }, this);
-
-            // reset state
-            window->DrawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+        if (mEnvTextures.GetCubeMap(*mEnvImg)) {
+            const PanelView view = this->GetPanelView(mCubeFacesRotation);
+            this->DoPanelTarget(mCubeFacesTarget, view, mCubeFacesPanelBounds, [this](const size_t width, const size_t height) {
+                this->DrawCubeFaces(width, height);
+            });
         }
 
-        if (ImGui::Button("Import##CubeFaces")) {
-            this->ImportCubeFaces();
-        }
-        if (ImGui::Button("Export##CubeFaces")) {
-            this->ExportCubeFaces();
+        if (this->DoJobUI(JobPanel::CubeFaces)) {
+            if (ImGui::Button("Import##CubeFaces")) {
+                this->ImportCubeFaces();
+            }
+            if (ImGui::Button("Export##CubeFaces")) {
+                this->ExportCubeFaces();
+            }
         }
     } ImGui::End();
 }
 
-void iCubeApp::DrawCubeFaces(const vec4& clipRect) {
-    mCubeFacesPanelBounds = clipRect;
+PanelView iCubeApp::GetPanelView(const vec2& rotation) {
+    PanelView view;
+    view.rotation = rotation;
+    view.cubeMap = mEnvImg->IsEmpty() ? 0u : mEnvTextures.GetCubeMap(*mEnvImg);
+    view.revision = mEnvImg->GetRevision();
+    view.format = scast<int>(mEnvTextures.GetFormat());
+    return view;
+}
+
+void iCubeApp::DoPanelTarget(PanelTarget& target, const PanelView& view, vec4& bounds, const std::function<void(const size_t, const size_t)>& draw) {
+    ImGuiWindow* window = ImGui::GetCurrentWindow();
+    const ImRect& rect = window->InnerClipRect;
+    bounds = vec4(rect.Min.x, rect.Min.y, rect.Max.x, rect.Max.y);
+
+    const ImVec2& scale = ImGui::GetIO().DisplayFramebufferScale;
+    const size_t width = scast<size_t>(Maximum(rect.GetWidth() * scale.x, 0.0f));
+    const size_t height = scast<size_t>(Maximum(rect.GetHeight() * scale.y, 0.0f));
 
-    const float wndLeftTopX = clipRect.x;
-    const float wndLeftTopY = clipRect.w;
-    const float wndWidth = clipRect.z - clipRect.x;
-    const float wndHeight = clipRect.w - clipRect.y;
+    // dragging another window or hovering a button doesn't touch the 3D panels
+    if (!target.IsCurrent(width, height, view) && target.Begin(width, height)) {
+        TRACE_ZONE("Render panel");
 
-    glViewport(scast<GLint>(wndLeftTopX), mHeight - scast<GLint>(wndLeftTopY), scast<GLsizei>(wndWidth), scast<GLsizei>(wndHeight));
+        draw(width, height);
+        target.End(view);
+
+        GLState::Get().Viewport(0, 0, mWidth, mHeight);
+    }
 
-    glDisable(GL_SCISSOR_TEST);
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
+    const GLuint texture = target.GetTexture();
+    if (texture) {
+        // GL textures are bottom up
+        window->DrawList->AddImage(rcast<ImTextureID>(scast<size_t>(texture)), rect.Min, rect.Max, ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+    }
+}
 
-    glUseProgram(mDrawFacesShader);
+void iCubeApp::DrawCubeFaces(const size_t width, const size_t height) {
+    GLState& state = GLState::Get();
+    state.SetEnabled(GL_DEPTH_TEST, true);
+    state.DepthFunc(GL_LEQUAL);
 
-    const GLint locProj = glGetUniformLocation(mDrawFacesShader, "gProj");
-    const GLint locModel = glGetUniformLocation(mDrawFacesShader, "gModel");
-    const GLint locTCube = glGetUniformLocation(mDrawFacesShader, "tCubeMap");
+    state.UseProgram(mDrawFacesShader);
 
     mat4 model = glm::rotate(mat4(1.0f), Deg2Rad(mCubeFacesRotation.x), vec3(0.0f, 1.0f, 0.0f));
     model = glm::rotate(model, Deg2Rad(mCubeFacesRotation.y), vec3(1.0f, 0.0f, 0.0f));
     model[3] = vec4(0.0f, 0.0f, -3.5f, 1.0f);
 
-    mat4 proj = MatPerspective(Deg2Rad(60.0f), wndWidth / wndHeight, 0.1f, 15.0f);
+    mat4 proj = MatPerspective(Deg2Rad(60.0f), scast<float>(width) / scast<float>(height), 0.1f, 15.0f);
 
-    if (locProj >= 0) {
-        glUniformMatrix4fv(locProj, 1, GL_FALSE, MatToPtr(proj));
-    }
-    if (locModel >= 0) {
-        glUniformMatrix4fv(locModel, 1, GL_FALSE, MatToPtr(model));
+    if (mDrawFacesUniforms.proj >= 0) {
+        glUniformMatrix4fv(mDrawFacesUniforms.proj, 1, GL_FALSE, MatToPtr(proj));
     }
-    if (locTCube >= 0) {
-        glUniform1i(locTCube, 0);
+    if (mDrawFacesUniforms.model >= 0) {
+        glUniformMatrix4fv(mDrawFacesUniforms.model, 1, GL_FALSE, MatToPtr(model));
     }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, mEnvImg.IsEmpty() ? 0u : mEnvImg.GetTextureCubeMap());
+    state.ActiveTexture(GL_TEXTURE0);
+    state.BindTexture(GL_TEXTURE_CUBE_MAP, mEnvImg->IsEmpty() ? 0u : mEnvTextures.GetCubeMap(*mEnvImg));
 
     // we don't provide any geometry - it'll be generated via vertex shader
-    glBindVertexArray(mJunkVAO);
+    state.BindVertexArray(mJunkVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
 }
 
-void iCubeApp::DrawPreviewPanel(const vec4& clipRect) {
-    mViewerPanelBounds = clipRect;
+void iCubeApp::DrawLatLongPanel(const vec4& imageRect) {
+    this->DrawProjectionPanel(mLatLongPanelShader, imageRect);
+}
+
+void iCubeApp::DrawCrossPanel(const vec4& imageRect) {
+    this->DrawProjectionPanel(mCrossPanelShader, imageRect);
+}
+
+void iCubeApp::DrawProjectionPanel(const GLuint shader, const vec4& imageRect) {
+    // everything in framebuffer pixels, mHeight is the window height and differs on HiDPI
+    const ImDrawData* drawData = ImGui::GetDrawData();
+    const ImVec2& displPos = drawData->DisplayPos;
+    const ImVec2& displScale = drawData->FramebufferScale;
+    const GLint fbHeight = scast<GLint>(drawData->DisplaySize.y * displScale.y);
+
+    const float left = (imageRect.x - displPos.x) * displScale.x;
+    const float top = (imageRect.y - displPos.y) * displScale.y;
+    const float right = (imageRect.z - displPos.x) * displScale.x;
+    const float bottom = (imageRect.w - displPos.y) * displScale.y;
+
+    GLState& state = GLState::Get();
+    state.Viewport(scast<GLint>(left), fbHeight - scast<GLint>(bottom), scast<GLsizei>(right - left), scast<GLsizei>(bottom - top));
 
-    const float wndLeftTopX = clipRect.x;
-    const float wndLeftTopY = clipRect.w;
-    const float wndWidth = clipRect.z - clipRect.x;
-    const float wndHeight = clipRect.w - clipRect.y;
+    state.SetEnabled(GL_SCISSOR_TEST, false);
+    state.SetEnabled(GL_DEPTH_TEST, false);
+    state.SetEnabled(GL_BLEND, false);
 
-    glViewport(scast<GLint>(wndLeftTopX), mHeight - scast<GLint>(wndLeftTopY), scast<GLsizei>(wndWidth), scast<GLsizei>(wndHeight));
+    state.UseProgram(shader);
 
-    glDisable(GL_SCISSOR_TEST);
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
+    state.ActiveTexture(GL_TEXTURE0);
+    state.BindTexture(GL_TEXTURE_CUBE_MAP, mEnvTextures.GetCubeMap(*mEnvImg));
 
-    glUseProgram(mViewerObjectShader);
+    // fullscreen triangle, generated in the vertex shader
+    state.BindVertexArray(mJunkVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void iCubeApp::DrawPreviewPanel(const size_t width, const size_t height) {
+    GLState& state = GLState::Get();
+    state.SetEnabled(GL_DEPTH_TEST, true);
+    state.DepthFunc(GL_LEQUAL);
 
-    const GLint locProj = glGetUniformLocation(mViewerObjectShader, "gProj");
-    const GLint locModel = glGetUniformLocation(mViewerObjectShader, "gModel");
-    const GLint locTCube = glGetUniformLocation(mViewerObjectShader, "tCubeMap");
+    state.UseProgram(mViewerObjectShader);
 
     mat4 model = glm::rotate(mat4(1.0f), Deg2Rad(mViewerRotation.x), vec3(0.0f, 1.0f, 0.0f));
     model = glm::rotate(model, Deg2Rad(mViewerRotation.y), vec3(1.0f, 0.0f, 0.0f));
     model[3] = vec4(0.0f, 0.0f, -3.5f, 1.0f);
 
-    mat4 proj = MatPerspective(Deg2Rad(60.0f), wndWidth / wndHeight, 0.1f, 15.0f);
+    mat4 proj = MatPerspective(Deg2Rad(60.0f), scast<float>(width) / scast<float>(height), 0.1f, 15.0f);
 
-    if (locProj >= 0) {
-        glUniformMatrix4fv(locProj, 1, GL_FALSE, MatToPtr(proj));
+    if (mViewerObjectUniforms.proj >= 0) {
+        glUniformMatrix4fv(mViewerObjectUniforms.proj, 1, GL_FALSE, MatToPtr(proj));
     }
-    if (locModel >= 0) {
-        glUniformMatrix4fv(locModel, 1, GL_FALSE, MatToPtr(model));
+    if (mViewerObjectUniforms.model >= 0) {
+        glUniformMatrix4fv(mViewerObjectUniforms.model, 1, GL_FALSE, MatToPtr(model));
     }
-    if (locTCube >= 0) {
-        glUniform1i(locTCube, 0);
+
+    state.ActiveTexture(GL_TEXTURE0);
+    state.BindTexture(GL_TEXTURE_CUBE_MAP, mEnvImg->IsEmpty() ? 0u : mEnvTextures.GetCubeMap(*mEnvImg));
+
+    if (mViewerLods.empty()) {
+        return;
     }
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, mEnvImg.IsEmpty() ? 0u : mEnvImg.GetTextureCubeMap());
+    // The object spans about half the panel height, ~1.55 x height pixels around.
+    // The coarsest LOD with at most ~4 pixels per segment, finer ones would only add subpixel triangles.
+    const size_t wantedResolution = height * 2 / 5;
+    size_t lodIndex = 0;
+    while (lodIndex + 1 < mViewerLods.size() && mViewerLods[lodIndex + 1].resolution >= wantedResolution) {
+        ++lodIndex;
+    }
+    const ViewerLod& lod = mViewerLods[lodIndex];
 
-    // we don't provide any geometry - it'll be generated via vertex shader
-    glBindVertexArray(mViewerVAO);
-    glDrawElements(GL_TRIANGLES, scast<GLsizei>(mViewerNumIndices), GL_UNSIGNED_INT, nullptr);
+    state.BindVertexArray(mViewerVAO);
+    glDrawElementsBaseVertex(GL_TRIANGLES, scast<GLsizei>(lod.numIndices), lod.indexType, rcast<const void*>(lod.indexOffset), lod.baseVertex);
 }
 
 
+bool iCubeApp::IsJobRunning() const {
+    return mJob.valid();
+}
+
+void iCubeApp::StartJob(const JobPanel panel, const JobFunc& job) {
+    if (this->IsJobRunning()) {
+        return;
+    }
+
+    mJobProgress = std::make_shared<JobProgress>();
+    mJobPanel = panel;
+
+    std::shared_ptr<JobProgress> progress = mJobProgress;
+    mJob = std::async(std::launch::async, [job, progress]() {
+        TRACE_THREAD_NAME("Job");
+
+        // whatever the loaders / savers throw (out of memory, filesystem errors) fails the job, never the app,
+        // that includes their ParallelFor tiles, the pool rethrows those here once the tiles have drained
+        EnvironmentImagePtr result;
+        try {
+            result = job(*progress);
+        } catch (const std::exception& e) {
+            fprintf(stderr, "Job failed: %s\n", e.what());
+        } catch (...) {
+            fprintf(stderr, "Job failed: unknown error\n");
+        }
+
+        // wake the main loop up, it may be waiting for events
+        glfwPostEmptyEvent();
+        return result;
+    });
+}
+
+void iCubeApp::StartImportJob(const JobPanel panel, const std::function<bool(EnvironmentImage&)>& load) {
+    this->StartJob(panel, [load](JobProgress& progress) -> EnvironmentImagePtr {
+        TRACE_ZONE("Import job");
+
+        // loads into a new image, the current one is still being drawn
+        EnvironmentImagePtr img = std::make_shared<EnvironmentImage>();
+        img->SetJobProgress(&progress);
+
+        bool result = false;
+        {
+            JobProgressScope loadScope(&progress, 0.0f, 0.4f);
+            result = load(*img);
+        }
+
+        // the viewer only needs the faces, derive them up front so all that's left for the main thread is the upload
+        if (result) {
+            JobProgressScope deriveScope(&progress, 0.4f, 1.0f);
+            img->GetCubeCross();
+        }
+
+        img->SetJobProgress(nullptr);
+
+        return (result && !progress.IsCancelled()) ? img : nullptr;
+    });
+}
+
+void iCubeApp::StartExportJob(const JobPanel panel, const std::function<bool(EnvironmentImage&)>& save) {
+    // the shown image is shared with the job, the main thread only reads its faces which imports derive up front
+    EnvironmentImagePtr img = mEnvImg;
+    const LdrExportSettings ldrExport = mLdrExport;
+    this->StartJob(panel, [img, ldrExport, save](JobProgress& progress) -> EnvironmentImagePtr {
+        TRACE_ZONE("Export job");
+
+        img->SetLdrExportSettings(ldrExport);
+        img->SetJobProgress(&progress);
+        try {
+            save(*img);
+        } catch (...) {
+            // the image outlives the job, it must not keep pointing at its progress
+            img->SetJobProgress(nullptr);
+            throw;
+        }
+        img->SetJobProgress(nullptr);
+
+        return nullptr;
+    });
+}
+
+void iCubeApp::PollJob() {
+    if (this->IsJobRunning() && mJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        EnvironmentImagePtr img = mJob.get();
+        if (img) {
+            mEnvImg = img;
+        }
+
+        mJobProgress = nullptr;
+        mJobPanel = JobPanel::None;
+
+        this->RequestRedraw();
+    }
+}
+
+void iCubeApp::CancelJob() {
+    if (this->IsJobRunning()) {
+        mJobProgress->Cancel();
+        mJob.wait();
+        this->PollJob();
+    }
+}
+
+bool iCubeApp::DoJobUI(const JobPanel panel) {
+    if (!this->IsJobRunning()) {
+        return true;
+    }
+
+    if (mJobPanel == panel) {
+        ImGui::ProgressBar(mJobProgress->GetProgress(), ImVec2(200.0f, 0.0f));
+        if (mJobProgress->IsCancelled()) {
+            ImGui::Text("Cancelling...");
+        } else if (ImGui::Button("Cancel")) {
+            mJobProgress->Cancel();
+        }
+    }
+
+    return false;
+}
+
 
 nfdchar_t* kSupportedFilesExtensions = "bmp,jpg,tga,png,hdr";
 nfdchar_t* kSupportedFilesExtensionsSep = "bmp;jpg;tga;png;hdr";
 
+void iCubeApp::SaveTrace(const fs::path& path) {
+    fs::path dstPath = path;
+    if (dstPath.empty()) {
+        nfdchar_t* outPath = nullptr;
+        if (NFD_OKAY == NFD_SaveDialog("json", nullptr, &outPath)) {
+            dstPath = outPath;
+        }
+    }
+
+    if (!dstPath.empty()) {
+        Trace::WriteChromeJson(dstPath);
+    }
+}
+
 // LatLong
 void iCubeApp::ImportLatLong(const fs::path& path) {
     fs::path srcPath = path;
@@ -472,7 +771,9 @@ void iCubeApp::ImportLatLong(const fs::path& path) {
     }
 
     if (!srcPath.empty()) {
-        mEnvImg.LoadLatLong(srcPath);
+        this->StartImportJob(JobPanel::LatLong, [srcPath](EnvironmentImage& img) {
+            return img.LoadLatLong(srcPath);
+        });
     }
 }
 
@@ -486,7 +787,9 @@ void iCubeApp::ExportLatLong(const fs::path& path) {
     }
 
     if (!dstPath.empty()) {
-        mEnvImg.SaveLatLong(dstPath);
+        this->StartExportJob(JobPanel::LatLong, [dstPath](EnvironmentImage& img) {
+            return img.SaveLatLong(dstPath);
+        });
     }
 }
 
@@ -501,7 +804,9 @@ void iCubeApp::ImportCubeCross(const fs::path& path) {
     }
 
     if (!srcPath.empty()) {
-        mEnvImg.LoadCubeCross(srcPath);
+        this->StartImportJob(JobPanel::CubeCross, [srcPath](EnvironmentImage& img) {
+            return img.LoadCubeCross(srcPath);
+        });
     }
 }
 
@@ -515,7 +820,9 @@ void iCubeApp::ExportCubeCross(const fs::path& path) {
     }
 
     if (!dstPath.empty()) {
-        mEnvImg.SaveCubeCross(dstPath);
+        this->StartExportJob(JobPanel::CubeCross, [dstPath](EnvironmentImage& img) {
+            return img.SaveCubeCross(dstPath);
+        });
     }
 }
 
@@ -535,7 +842,9 @@ void iCubeApp::ImportCubeFaces(const Array<fs::path> paths) {
     }
 
     if (!srcPaths.empty()) {
-        mEnvImg.LoadCubeFaces(srcPaths);
+        this->StartImportJob(JobPanel::CubeFaces, [srcPaths](EnvironmentImage& img) {
+            return img.LoadCubeFaces(srcPaths);
+        });
     }
 }
 
@@ -549,7 +858,9 @@ void iCubeApp::ExportCubeFaces(const fs::path& path) {
     }
 
     if (!dstPath.empty()) {
-        mEnvImg.SaveCubeFaces(dstPath);
+        this->StartExportJob(JobPanel::CubeFaces, [dstPath](EnvironmentImage& img) {
+            return img.SaveCubeFaces(dstPath);
+        });
     }
 }
 
@@ -560,6 +871,12 @@ const char gCubeFacesShaderCode[] = {
 const char gViewerObjectShaderCode[] = {
 #include "shaders/viewer_object.glsl"
 };
+const char gLatLongPanelShaderCode[] = {
+#include "shaders/latlong_panel.glsl"
+};
+const char gCrossPanelShaderCode[] = {
+#include "shaders/cross_panel.glsl"
+};
 
 static GLuint CompileGLSLShader(const String& source, const bool isVertex) {
     GLuint shader = glCreateShader(isVertex ? GL_VERTEX_SHADER : GL_FRAGMENT_SHADER);
@@ -635,96 +952,116 @@ GLuint CreateGLSLProgram(const String& shaderSource) {
     return program;
 }
 
+// the cube map always goes to unit 0, set once so draws don't have to
+static void BindCubeMapUnit(const GLuint program) {
+    if (program != GL_NONE) {
+        const GLint locTCube = glGetUniformLocation(program, "tCubeMap");
+        if (locTCube >= 0) {
+            glProgramUniform1i(program, locTCube, 0);
+        }
+    }
+}
+
+static iCubeApp::ObjectUniforms GetObjectUniforms(const GLuint program) {
+    iCubeApp::ObjectUniforms uniforms = { -1, -1 };
+    if (program != GL_NONE) {
+        uniforms.proj = glGetUniformLocation(program, "gProj");
+        uniforms.model = glGetUniformLocation(program, "gModel");
+    }
+    BindCubeMapUnit(program);
+    return uniforms;
+}
+
 void iCubeApp::PrepareRenderer() {
     mDrawFacesShader = CreateGLSLProgram(gCubeFacesShaderCode);
+    mDrawFacesUniforms = GetObjectUniforms(mDrawFacesShader);
     glGenVertexArrays(1, &mJunkVAO);
 
+    mLatLongPanelShader = CreateGLSLProgram(gLatLongPanelShaderCode);
+    mCrossPanelShader = CreateGLSLProgram(gCrossPanelShaderCode);
+    BindCubeMapUnit(mLatLongPanelShader);
+    BindCubeMapUnit(mCrossPanelShader);
+
     mCubeFacesRotation = vec2(30.0f, 35.0f);
 
     // viewer
-    this->GenerateRoundedCube(128, 0.2f);
+    this->PrepareViewerMeshes();
     mViewerObjectShader = CreateGLSLProgram(gViewerObjectShaderCode);
+    mViewerObjectUniforms = GetObjectUniforms(mViewerObjectShader);
 
     mViewerRotation = vec2(330.0f, 35.0f);
 }
 
 
-static float SignPower(const float v, const float n) {
-    if (v >= 0.0f) {
-        return std::powf(v, n);
-    } else {
-        return -std::powf(-v, n);
-    }
-}
-
-void iCubeApp::GenerateRoundedCube(const size_t resolution, const float power) {
-    Array<vec3> vertices((resolution + 1) * (resolution / 2 + 1));
-    vec3* vb = vertices.data();
-
-    const float invRes = 1.0f / scast<float>(resolution);
-    const float invHalfRes = 1.0f / scast<float>(resolution / 2);
+void iCubeApp::PrepareViewerMeshes() {
+    TRACE_ZONE("PrepareViewerMeshes");
 
-    // Pole is along the z axis
-    for (size_t j = 0; j <= resolution / 2; ++j) {
-        for (size_t i = 0; i <= resolution; i++) {
-            const size_t index = j * (resolution + 1) + i;
-            const float theta = scast<float>(i) * MM_TwoPi * invRes;
-            const float phi = -MM_HalfPi + MM_Pi * scast<float>(j) * invHalfRes;
+    // finest first
+    const Array<size_t> resolutions = { 128, 64, 32, 16 };
+    const float power = 0.2f;
 
-            vec3& pos = vb[index];
+    // the optimized chain is kept across runs
+    std::error_code ec;
+    const fs::path tempFolder = fs::temp_directory_path(ec);
+    const fs::path cachePath = ec ? fs::path() : tempFolder / "icube_viewer_meshes.bin";
 
-            // unit sphere, power determines roundness
-            pos.x = SignPower(std::cosf(phi), power) * SignPower(std::cosf(theta), power);
-            pos.y = SignPower(std::cosf(phi), power) * SignPower(std::sinf(theta), power);
-            pos.z = SignPower(std::sinf(phi), power);
+    Array<ViewerMesh> meshes;
+    if (cachePath.empty() || !LoadViewerMeshes(cachePath, resolutions, power, meshes)) {
+        meshes.resize(resolutions.size());
+        for (size_t i = 0; i < resolutions.size(); ++i) {
+            GenerateRoundedCube(resolutions[i], power, meshes[i]);
+            OptimizeViewerMesh(meshes[i]);
+        }
 
-            // seams
-            if (j == 0) {
-                pos.x = 0.0f;
-                pos.y = 0.0f;
-                pos.z = -1.0f;
-            }
-            if (j == resolution / 2) {
-                pos.x = 0.0f;
-                pos.y = 0.0f;
-                pos.z = 1.0f;
-            }
-            if (i == resolution) {
-                pos.x = vb[j * (resolution + 1) + i - resolution].x;
-                pos.y = vb[j * (resolution + 1) + i - resolution].y;
-            }
+        if (!cachePath.empty()) {
+            SaveViewerMeshes(cachePath, power, meshes);
         }
     }
 
-    Array<uint32_t> indices(resolution * (resolution / 2) * 6);
-    uint32_t* ib = indices.data();
-    for (size_t j = 0; j < resolution / 2; ++j) {
-        for (size_t i = 0; i < resolution; ++i, ib += 6) {
-            const uint32_t a = scast<uint32_t>(j * (resolution + 1) + i);
-            const uint32_t b = scast<uint32_t>(j * (resolution + 1) + (i + 1));
-            const uint32_t c = scast<uint32_t>((j + 1) * (resolution + 1) + (i + 1));
-            const uint32_t d = scast<uint32_t>((j + 1) * (resolution + 1) + i);
-
-            ib[0] = a; ib[1] = b; ib[2] = c;
-            ib[3] = a; ib[4] = c; ib[5] = d;
+    // all the LODs share one vertex and one index buffer, 16 bit indices whenever they fit
+    Array<vec3> vertices;
+    BytesArray indices;
+    mViewerLods.clear();
+    for (const ViewerMesh& mesh : meshes) {
+        ViewerLod lod;
+        lod.resolution = mesh.resolution;
+        lod.numIndices = mesh.indices.size();
+        lod.indexType = mesh.vertices.size() <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        lod.indexOffset = indices.size();
+        lod.baseVertex = scast<GLint>(vertices.size());
+
+        if (lod.indexType == GL_UNSIGNED_SHORT) {
+            indices.resize(indices.size() + mesh.indices.size() * sizeof(uint16_t));
+            uint16_t* dst = rcast<uint16_t*>(indices.data() + lod.indexOffset);
+            for (const uint32_t index : mesh.indices) {
+                *dst++ = scast<uint16_t>(index);
+            }
+        } else {
+            indices.resize(indices.size() + mesh.indices.size() * sizeof(uint32_t));
+            std::memcpy(indices.data() + lod.indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
         }
+        // keeps the next LOD's 32 bit indices aligned
+        indices.resize((indices.size() + 3) & ~size_t(3));
+
+        vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        mViewerLods.push_back(lod);
     }
 
+    GLState& state = GLState::Get();
+
     glGenVertexArrays(1, &mViewerVAO);
-    glBindVertexArray(mViewerVAO);
+    state.BindVertexArray(mViewerVAO);
 
     glGenBuffers(1, &mViewerVB);
     glGenBuffers(1, &mViewerIB);
 
-    glBindBuffer(GL_ARRAY_BUFFER, mViewerVB);
+    state.BindBuffer(GL_ARRAY_BUFFER, mViewerVB);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vec3), vertices.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mViewerIB);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
-
-    glBindVertexArray(0);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size(), indices.data(), GL_STATIC_DRAW);
 
-    mViewerNumIndices = indices.size();
+    state.BindVertexArray(0);
 }
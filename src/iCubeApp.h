@@ -1,8 +1,44 @@
 #pragma once
 #include "mycommon.h"
 #include "EnvironmentImage.h"
+#include "EnvironmentTextures.h"
+#include "JobProgress.h"
+#include "PanelTarget.h"
+#include "ViewerMesh.h"
+
+#include <functional>
+#include <future>
 
 class iCubeApp {
+    using EnvironmentImagePtr = std::shared_ptr<EnvironmentImage>;
+
+    // the panel that started the background job, shows its progress
+    enum class JobPanel {
+        None,
+        LatLong,
+        CubeCross,
+        CubeFaces
+    };
+
+    // runs on a worker thread, returns the new image to show (imports) or nullptr
+    using JobFunc = std::function<EnvironmentImagePtr(JobProgress& progress)>;
+
+public:
+    // of the 3D object programs, resolved once the program is linked
+    struct ObjectUniforms {
+        GLint   proj;
+        GLint   model;
+    };
+
+    // one level of the viewer object in the shared vertex / index buffers
+    struct ViewerLod {
+        size_t  resolution;
+        size_t  numIndices;
+        GLenum  indexType;
+        size_t  indexOffset;    // bytes
+        GLint   baseVertex;
+    };
+
 public:
     iCubeApp();
     ~iCubeApp();
@@ -17,9 +53,35 @@ private:
     void        OnMouseButton(const int button, const int action, const int mods);
     void        OnUpdate(const float dt);
 
+    // The UI is only redrawn when something changed: input, resize, a finished job.
+    // Jobs in flight and streaming uploads keep it animating, up to mMaxFrameRate.
+    void        RequestRedraw();
+    bool        IsAnimating() const;
+
     void        DoUI();
-    void        DrawCubeFaces(const vec4& clipRect);
-    void        DrawPreviewPanel(const vec4& clipRect);
+    // The 3D panels are rendered into their own target, again only when their PanelView changed.
+    // `bounds` is set to the panel rect in screen coordinates (mouse hit tests)
+    PanelView   GetPanelView(const vec2& rotation);
+    void        DoPanelTarget(PanelTarget& target, const PanelView& view, vec4& bounds, const std::function<void(const size_t, const size_t)>& draw);
+    void        DrawCubeFaces(const size_t width, const size_t height);
+    void        DrawPreviewPanel(const size_t width, const size_t height);
+    void        DrawLatLongPanel(const vec4& imageRect);
+    void        DrawCrossPanel(const vec4& imageRect);
+    // `imageRect` in ImGui screen coordinates
+    void        DrawProjectionPanel(const GLuint shader, const vec4& imageRect);
+
+    // Background import / export, one at a time. The current image stays on screen until an import is done.
+    bool        IsJobRunning() const;
+    void        StartJob(const JobPanel panel, const JobFunc& job);
+    void        StartImportJob(const JobPanel panel, const std::function<bool(EnvironmentImage&)>& load);
+    void        StartExportJob(const JobPanel panel, const std::function<bool(EnvironmentImage&)>& save);
+    void        PollJob();
+    void        CancelJob();
+    // progress and Cancel if this panel's job is running, returns true if a new job can be started
+    bool        DoJobUI(const JobPanel panel);
+
+    // Chrome / Perfetto JSON of the recorded trace zones
+    void        SaveTrace(const fs::path& path = fs::path());
 
     // LatLong
     void        ImportLatLong(const fs::path& path = fs::path());
@@ -33,13 +95,23 @@ private:
 
     // render stuff
     void        PrepareRenderer();
-    void        GenerateRoundedCube(const size_t resolution, const float power);
+    // the viewer object's LOD chain, cached on disk between runs
+    void        PrepareViewerMeshes();
 
 private:
     void*               mWindow;
     int                 mWidth;
     int                 mHeight;
-    EnvironmentImage    mEnvImg;
+    int                 mRedrawFrames;
+    int                 mMaxFrameRate;
+    LdrExportSettings   mLdrExport;
+    EnvironmentImagePtr mEnvImg;
+    EnvironmentTextures mEnvTextures;
+
+    // background job
+    std::future<EnvironmentImagePtr>    mJob;
+    std::shared_ptr<JobProgress>        mJobProgress;
+    JobPanel                            mJobPanel;
 
     vec4                mViewerPanelBounds;
     vec4                mCubeFacesPanelBounds;
@@ -47,16 +119,26 @@ private:
 
     // cube faces draw
     GLuint              mDrawFacesShader;
+    ObjectUniforms      mDrawFacesUniforms;
+    PanelTarget         mCubeFacesTarget;
     GLuint              mJunkVAO;
     bool                mCubeFacesMouseDown;
     vec2                mCubeFacesRotation;
 
+    // LatLong / cross panels draw
+    GLuint              mLatLongPanelShader;
+    GLuint              mCrossPanelShader;
+    vec4                mLatLongImageRect;
+    vec4                mCrossImageRect;
+
     // viewer draw
     GLuint              mViewerObjectShader;
+    ObjectUniforms      mViewerObjectUniforms;
+    PanelTarget         mViewerTarget;
     GLuint              mViewerVAO;
     GLuint              mViewerVB;
     GLuint              mViewerIB;
-    size_t              mViewerNumIndices;
+    Array<ViewerLod>    mViewerLods;
     bool                mViewerMouseDown;
     vec2                mViewerRotation;
 };
@@ -1,6 +1,135 @@
 #include "iCubeApp.h"
+#include "BatchConverter.h"
+#include "Trace.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const char* sSupportedExtensions[] = {
+    ".bmp", ".jpg", ".tga", ".png", ".hdr"
+};
+
+static void PrintConvertUsage() {
+    fprintf(stderr,
+            "usage: iCube convert --in <files or folders...> --to <latlong|cross|faces> --out <folder>\n"
+            "                     [--from <auto|latlong|cross>] [--ext <.hdr|.png|...>]\n"
+            "                     [--jobs <n>] [--mem-mb <n>] [--fast] [--trace <file.json>]\n"
+            "                     [--exposure <stops>] [--tonemap <clamp|reinhard|aces>] [--dither <none|ordered|bluenoise>] [--linear]\n");
+}
+
+static bool IsSupportedImage(const fs::path& path) {
+    const String extension = GetFileFormatExtension(path);
+    for (const char* supported : sSupportedExtensions) {
+        if (extension == supported) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Headless mode, never creates a window or a GL context
+static int RunConvert(const int argc, char** argv) {
+    Array<fs::path> inputs;
+    fs::path outFolder;
+    fs::path tracePath;
+    BatchConverter::Format from = BatchConverter::Format::Auto;
+    BatchConverter::Format to = BatchConverter::Format::Auto;
+    BatchConverter converter;
+    LdrExportSettings ldrExport = GetDefaultLdrExportSettings();
+
+    for (int i = 2; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = (i + 1) < argc;
+
+        if (!strcmp(arg, "--in")) {
+            for (; (i + 1) < argc && strncmp(argv[i + 1], "--", 2); ++i) {
+                const fs::path path = fs::u8path(argv[i + 1]);
+                // an unreadable or vanished input is reported and skipped, never aborts the batch
+                std::error_code ec;
+                const fs::file_status status = fs::status(path, ec);
+                if (ec) {
+                    fprintf(stderr, "skipping %s: %s\n", path.u8string().c_str(), ec.message().c_str());
+                } else if (fs::is_directory(status)) {
+                    fs::directory_iterator it(path, ec);
+                    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+                        std::error_code entryEc;
+                        if (it->is_regular_file(entryEc) && IsSupportedImage(it->path())) {
+                            inputs.push_back(it->path());
+                        }
+                    }
+                    if (ec) {
+                        fprintf(stderr, "couldn't list all of %s: %s\n", path.u8string().c_str(), ec.message().c_str());
+                    }
+                } else {
+                    inputs.push_back(path);
+                }
+            }
+        } else if (!strcmp(arg, "--out") && hasValue) {
+            outFolder = fs::u8path(argv[++i]);
+        } else if (!strcmp(arg, "--to") && hasValue) {
+            if (!BatchConverter::ParseFormat(argv[++i], to)) {
+                to = BatchConverter::Format::Auto;
+            }
+        } else if (!strcmp(arg, "--from") && hasValue) {
+            if (!BatchConverter::ParseFormat(argv[++i], from)) {
+                PrintConvertUsage();
+                return 1;
+            }
+        } else if (!strcmp(arg, "--ext") && hasValue) {
+            converter.SetOutputExtension(argv[++i]);
+        } else if (!strcmp(arg, "--jobs") && hasValue) {
+            converter.SetMaxJobs(scast<size_t>(strtoull(argv[++i], nullptr, 10)));
+        } else if (!strcmp(arg, "--mem-mb") && hasValue) {
+            converter.SetMemoryBudget(scast<size_t>(strtoull(argv[++i], nullptr, 10)) << 20);
+        } else if (!strcmp(arg, "--trace") && hasValue) {
+            tracePath = fs::u8path(argv[++i]);
+        } else if (!strcmp(arg, "--fast")) {
+            converter.SetMathPrecision(MathPrecision::Fast);
+        } else if (!strcmp(arg, "--exposure") && hasValue) {
+            ldrExport.exposure = strtof(argv[++i], nullptr);
+        } else if (!strcmp(arg, "--tonemap") && hasValue) {
+            if (!ParseToneMapOperator(argv[++i], ldrExport.toneMap)) {
+                PrintConvertUsage();
+                return 1;
+            }
+        } else if (!strcmp(arg, "--dither") && hasValue) {
+            if (!ParseDitherMode(argv[++i], ldrExport.dither)) {
+                PrintConvertUsage();
+                return 1;
+            }
+        } else if (!strcmp(arg, "--linear")) {
+            ldrExport.sRGB = false;
+        } else {
+            PrintConvertUsage();
+            return 1;
+        }
+    }
+
+    if (inputs.empty() || outFolder.empty() || to == BatchConverter::Format::Auto) {
+        PrintConvertUsage();
+        return 1;
+    }
+
+    converter.SetLdrExportSettings(ldrExport);
+
+    std::sort(inputs.begin(), inputs.end());
+
+    const bool result = converter.Run(inputs, from, to, outFolder);
+    converter.PrintReport(stdout);
+
+    if (!tracePath.empty() && !Trace::WriteChromeJson(tracePath)) {
+        fprintf(stderr, "couldn't write the trace to %s%s\n", tracePath.u8string().c_str(),
+                Trace::IsEnabled() ? "" : " (tracing is compiled out, rebuild with ICUBE_ENABLE_TRACE=ON)");
+    }
+
+    return result ? 0 : 2;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && !strcmp(argv[1], "convert")) {
+        return RunConvert(argc, argv);
+    }
 
-int main(int, char**) {
     iCubeApp app;
     if (app.Initialize()) {
         app.Loop();
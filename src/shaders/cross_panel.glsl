@@ -0,0 +1,64 @@
+R"===(
+struct Vertex2Fragment {
+    vec2 UV;
+};
+
+#ifdef VERTEX_SHADER
+
+out Vertex2Fragment v2f;
+
+void main() {
+    // fullscreen triangle, v goes down like the image rows
+    vec2 pos = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+
+    v2f.UV = vec2(pos.x * 0.5 + 0.5, 0.5 - pos.y * 0.5);
+
+    gl_Position = vec4(pos, 0.0, 1.0);
+}
+
+#endif
+
+#ifdef FRAGMENT_SHADER
+
+uniform samplerCube tCubeMap;
+
+in Vertex2Fragment v2f;
+
+out vec4 Target0;
+
+// Vertical cross layout
+//
+//      |+Y|
+//   |-X|+Z|+X|
+//      |-Y|
+//      |-Z|    <- stored rotated 180
+//
+void main() {
+    vec2 cell = v2f.UV * vec2(3.0, 4.0);
+    ivec2 cellId = ivec2(min(floor(cell), vec2(2.0, 3.0)));
+    // face uv in [-1, 1], same axes as the cube map faces
+    vec2 st = fract(cell) * 2.0 - 1.0;
+
+    vec3 dir;
+    if (cellId.y == 1 && cellId.x == 2) {
+        dir = vec3( 1.0, -st.y, -st.x);     // +X
+    } else if (cellId.y == 1 && cellId.x == 0) {
+        dir = vec3(-1.0, -st.y,  st.x);     // -X
+    } else if (cellId.x != 1) {
+        Target0 = vec4(0.0, 0.0, 0.0, 1.0); // outside the cross
+        return;
+    } else if (cellId.y == 0) {
+        dir = vec3( st.x,  1.0,  st.y);     // +Y
+    } else if (cellId.y == 2) {
+        dir = vec3( st.x, -1.0, -st.y);     // -Y
+    } else if (cellId.y == 1) {
+        dir = vec3( st.x, -st.y,  1.0);     // +Z
+    } else {
+        dir = vec3( st.x,  st.y, -1.0);     // -Z, (-s, -t) of the rotated face
+    }
+
+    Target0 = vec4(texture(tCubeMap, dir).xyz, 1.0);
+}
+
+#endif
+)==="
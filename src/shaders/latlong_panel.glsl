@@ -0,0 +1,41 @@
+R"===(
+struct Vertex2Fragment {
+    vec2 UV;
+};
+
+#ifdef VERTEX_SHADER
+
+out Vertex2Fragment v2f;
+
+void main() {
+    // fullscreen triangle, v goes down like the image rows
+    vec2 pos = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+
+    v2f.UV = vec2(pos.x * 0.5 + 0.5, 0.5 - pos.y * 0.5);
+
+    gl_Position = vec4(pos, 0.0, 1.0);
+}
+
+#endif
+
+#ifdef FRAGMENT_SHADER
+
+#define PI 3.14159265358979
+
+uniform samplerCube tCubeMap;
+
+in Vertex2Fragment v2f;
+
+out vec4 Target0;
+
+void main() {
+    // same mapping as LatLongToDir
+    float phi = v2f.UV.x * (2.0 * PI);
+    float theta = v2f.UV.y * PI;
+    vec3 dir = vec3(-sin(theta) * sin(phi), cos(theta), -sin(theta) * cos(phi));
+
+    Target0 = vec4(texture(tCubeMap, dir).xyz, 1.0);
+}
+
+#endif
+)==="